@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// CPUs to pin to, in increasing order.
+static int cpus[CPU_SETSIZE];
+static size_t num_cpus = 0;
+
+/// Whether carriers are placed on consecutive CPUs instead of spread out.
+static int pack = 0;
+
+/// The configured CPUs, as given on the command line.
+static char cpu_list_str[256];
+
+// Set the CPUs to pin to
+int affinity_configure(const char *cpu_list, const char *policy) {
+    if (policy != NULL && strcmp(policy, "pack") != 0 &&
+        strcmp(policy, "spread") != 0) {
+        fprintf(stderr, "Invalid placement policy: %s\n", policy);
+        return 1;
+    }
+    pack = policy != NULL && strcmp(policy, "pack") == 0;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (cpu_list == NULL) {
+        // Default to the CPUs the process may already run on
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+            perror("Error getting CPU affinity");
+            return 1;
+        }
+    } else {
+        // Parse a comma separated list of CPUs and ranges of CPUs
+        const char *current = cpu_list;
+        while (*current != '\0') {
+            char *end;
+            unsigned long from = strtoul(current, &end, 10);
+            unsigned long to = from;
+            if (end == current) {
+                fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+                return 1;
+            }
+
+            if (*end == '-') {
+                current = end + 1;
+                to = strtoul(current, &end, 10);
+                if (end == current) {
+                    fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+                    return 1;
+                }
+            }
+
+            if (from > to || to >= CPU_SETSIZE ||
+                (*end != ',' && *end != '\0')) {
+                fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+                return 1;
+            }
+
+            for (unsigned long cpu = from; cpu <= to; cpu++) {
+                CPU_SET(cpu, &set);
+            }
+            current = *end == ',' ? end + 1 : end;
+        }
+    }
+
+    num_cpus = 0;
+    for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus[num_cpus++] = (int)cpu;
+        }
+    }
+
+    if (num_cpus == 0) {
+        fprintf(stderr, "Invalid CPU list: no CPUs\n");
+        return 1;
+    }
+
+    snprintf(cpu_list_str, sizeof(cpu_list_str), "%s",
+             cpu_list != NULL ? cpu_list : "all");
+    return 0;
+}
+
+int affinity_enabled() { return num_cpus > 0; }
+
+// Pin the calling process to the configured CPUs
+int affinity_pin_process() {
+    if (!affinity_enabled()) {
+        return 0;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < num_cpus; i++) {
+        CPU_SET((size_t)cpus[i], &set);
+    }
+
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        perror("Error setting CPU affinity");
+        return 1;
+    }
+
+    printf("Child process [%d] pinned to CPUs %s, carriers %s\n", getpid(),
+           cpu_list_str, pack ? "packed" : "spread");
+    return 0;
+}
+
+// Pin the calling carrier thread to one of the configured CPUs
+int affinity_pin_carrier(size_t index, size_t num_carriers) {
+    if (!affinity_enabled()) {
+        return 0;
+    }
+
+    // Packed carriers take consecutive CPUs, spread carriers are placed at
+    // even strides so they land on as many cores and nodes as possible
+    size_t slot = index % num_cpus;
+    if (!pack && num_carriers < num_cpus) {
+        slot = index * num_cpus / num_carriers;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((size_t)cpus[slot], &set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Error pinning carrier to CPU %d\n", cpus[slot]);
+        return 1;
+    }
+    return 0;
+}
+
+// Get the CPU and NUMA node of the calling thread
+void affinity_current(int *cpu, int *node) {
+    unsigned int current_cpu, current_node;
+    if (getcpu(&current_cpu, &current_node) != 0) {
+        *cpu = -1;
+        *node = -1;
+        return;
+    }
+
+    *cpu = (int)current_cpu;
+    *node = (int)current_node;
+}
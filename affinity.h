@@ -0,0 +1,33 @@
+#ifndef EMS_AFFINITY_H
+#define EMS_AFFINITY_H
+
+#include <stddef.h>
+
+/// Sets the CPUs that child processes and their carrier threads are pinned
+/// to, and how carriers are placed on them.
+/// @param cpu_list CPUs such as "0-3,8", NULL for every CPU the process may
+/// run on.
+/// @param policy "pack" to place carriers on consecutive CPUs, "spread" to
+/// spread them evenly over the CPUs, NULL for "spread".
+/// @return 0 if the placement is valid, 1 otherwise.
+int affinity_configure(const char *cpu_list, const char *policy);
+
+/// Returns whether pinning was enabled with affinity_configure().
+int affinity_enabled();
+
+/// Pins the calling process to the configured CPUs and reports it on stdout.
+/// @return 0 if the process was pinned successfully, 1 otherwise.
+int affinity_pin_process();
+
+/// Pins the calling carrier thread to one of the configured CPUs.
+/// @param index Index of the carrier.
+/// @param num_carriers Number of carriers of the process.
+/// @return 0 if the thread was pinned successfully, 1 otherwise.
+int affinity_pin_carrier(size_t index, size_t num_carriers);
+
+/// Gets the CPU and NUMA node the calling thread is running on.
+/// @param cpu Set to the CPU, -1 if unknown.
+/// @param node Set to the NUMA node, -1 if unknown.
+void affinity_current(int *cpu, int *node);
+
+#endif // EMS_AFFINITY_H
@@ -0,0 +1,126 @@
+#include "autoconfig.h"
+#include "constants.h"
+#include "parallelization.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Commands found in the .jobs files.
+struct CommandMix {
+    double commands;   // Commands, estimated from the sampled ones.
+    double serialized; // Commands that hold the output file lock.
+    double largest;    // Commands of the largest file.
+};
+
+/// Returns whether a command line holds the output file lock while it runs,
+/// so that it does not run in parallel with other such commands.
+static int is_serialized(const char *line) {
+    static const char *const prefixes[] = {"SHOW", "LIST", "STATS", "HELP",
+                                           "RESERVE_BEST"};
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++) {
+        if (strncmp(line, prefixes[i], strlen(prefixes[i])) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/// Counts the commands of a .jobs file, reading at most AUTO_SAMPLE_BYTES
+/// and scaling the counts by the size of the file.
+static void sample_jobs_file(const char *path, struct CommandMix *mix) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return; // The child reports the error when it opens the file
+    }
+
+    struct stat st;
+    double size = fstat(fileno(file), &st) == 0 ? (double)st.st_size : 0;
+
+    char buffer[256];
+    size_t read_bytes = 0, commands = 0, serialized = 0;
+    int line_start = 1;
+    while (read_bytes < AUTO_SAMPLE_BYTES &&
+           fgets(buffer, sizeof(buffer), file) != NULL) {
+        size_t len = strlen(buffer);
+        read_bytes += len;
+
+        // Long lines are read in pieces; only their start names the command
+        if (line_start && buffer[0] != '\n') {
+            commands++;
+            serialized += (size_t)is_serialized(buffer);
+        }
+        line_start = buffer[len - 1] == '\n';
+    }
+    fclose(file);
+
+    double scale = read_bytes > 0 && size > (double)read_bytes
+                       ? size / (double)read_bytes
+                       : 1;
+    mix->commands += (double)commands * scale;
+    mix->serialized += (double)serialized * scale;
+    if ((double)commands * scale > mix->largest) {
+        mix->largest = (double)commands * scale;
+    }
+}
+
+// Choose the process and thread counts
+int auto_configure(const char *dir_path, int *num_procs, int *num_threads) {
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) {
+        perror("Error opening directory");
+        return 1;
+    }
+
+    struct CommandMix mix = {0, 0, 0};
+    int num_files = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (endsWith(entry->d_name, ".jobs")) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+            sample_jobs_file(path, &mix);
+            num_files++;
+        }
+    }
+    closedir(dir);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        cpus = 1;
+    }
+
+    // One process per file, as long as each gets a CPU
+    if (*num_procs == 0) {
+        *num_procs = num_files < cpus ? num_files : (int)cpus;
+        if (*num_procs < 1) {
+            *num_procs = 1;
+        }
+    }
+
+    // Split the CPUs between the processes. Commands that hold the output
+    // lock run one at a time, so with a share s of them no number of threads
+    // is more than 1/s times faster than one thread; threads beyond that only
+    // contend. A thread without a command of its own is useless too.
+    double share = mix.commands > 0 ? mix.serialized / mix.commands : 0;
+    if (*num_threads == 0) {
+        int threads = (int)(cpus / *num_procs);
+        if (share > 0 && threads > (int)(1 / share + 0.5)) {
+            threads = (int)(1 / share + 0.5);
+        }
+        if (threads > (int)mix.largest) {
+            threads = (int)mix.largest;
+        }
+        *num_threads = threads < 1 ? 1 : threads;
+    }
+
+    printf("Auto configuration: %d processes, %d threads per process "
+           "(%ld CPUs, %d files, %.0f commands, %.0f%% serialized)\n",
+           *num_procs, *num_threads, cpus, num_files, mix.commands,
+           share * 100);
+
+    // Children must not print it again when they flush their copy
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef EMS_AUTOCONFIG_H
+#define EMS_AUTOCONFIG_H
+
+/// Chooses the number of processes and of threads per process for the .jobs
+/// files of a directory, from the number of online CPUs, the number and
+/// sizes of the files and the mix of commands in them, and logs the choice.
+/// @param dir_path Directory of the .jobs files.
+/// @param num_procs Number of processes, chosen if it is 0.
+/// @param num_threads Number of threads per process, chosen if it is 0.
+/// @return 0 if the counts were chosen successfully, 1 otherwise.
+int auto_configure(const char *dir_path, int *num_procs, int *num_threads);
+
+#endif // EMS_AUTOCONFIG_H
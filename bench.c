@@ -0,0 +1,281 @@
+/*
+Contention microbenchmark for the operations.c API.
+Drives ems_create, ems_reserve and ems_show directly from several threads,
+with no state access delay, so only the cost of synchronization is measured.
+
+Usage: ./bench [-t threads] [-n ops_per_thread] [pattern ...]
+Patterns: hotspot, samerow, disjoint, mix (all of them by default).
+*/
+
+#include "operations.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Attempts at other seats before a samerow reservation gives up
+#define MAX_RETRIES 8
+
+/// Results of one benchmark thread.
+struct BenchThread {
+    pthread_t thread;
+    unsigned int id;     // Thread id, starting at 0.
+    uint64_t *latencies; // Latency of every operation, in nanoseconds.
+    size_t aborts;       // Reservations that failed because seats were taken.
+    size_t retries;      // Reservations attempted again at other seats.
+    unsigned int seed;   // State of the thread's random generator.
+};
+
+/// An access pattern.
+struct Pattern {
+    const char *name;
+    const char *description;
+    void (*setup)(void);
+    int (*op)(struct BenchThread *thread, size_t i);
+};
+
+static unsigned int num_threads = 4;
+static size_t num_ops = 10000;
+static int null_fd = -1;
+
+/// Returns the monotonic clock in nanoseconds.
+static uint64_t clock_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+/// Returns the next number of a thread's random generator.
+static size_t next_random(struct BenchThread *thread) {
+    thread->seed = thread->seed * 1103515245 + 12345;
+    return thread->seed >> 8;
+}
+
+/// Reserves a single seat.
+static int reserve_seat(unsigned int event_id, size_t row, size_t col) {
+    return ems_reserve(event_id, 1, &row, &col);
+}
+
+// Every thread reserves the same seat, so all but one attempt abort
+static void setup_hotspot() { ems_create(1, 1, 1); }
+
+static int op_hotspot(struct BenchThread *thread, size_t i) {
+    (void)i;
+    if (reserve_seat(1, 1, 1) != 0) {
+        thread->aborts++;
+    }
+    return 0;
+}
+
+// Every thread reserves random seats of a single row, retrying on conflict
+static void setup_samerow() {
+    ems_create(1, 1, (size_t)num_threads * num_ops * 2);
+}
+
+static int op_samerow(struct BenchThread *thread, size_t i) {
+    (void)i;
+    size_t cols = (size_t)num_threads * num_ops * 2;
+    for (int attempt = 0; attempt <= MAX_RETRIES; attempt++) {
+        if (attempt > 0) {
+            thread->retries++;
+        }
+        if (reserve_seat(1, 1, next_random(thread) % cols + 1) == 0) {
+            return 0;
+        }
+        thread->aborts++;
+    }
+    return 1;
+}
+
+// Every thread reserves the seats of its own event
+static void setup_disjoint() {
+    for (unsigned int t = 0; t < num_threads; t++) {
+        ems_create(t + 1, 1, num_ops);
+    }
+}
+
+static int op_disjoint(struct BenchThread *thread, size_t i) {
+    if (reserve_seat(thread->id + 1, 1, i + 1) != 0) {
+        thread->aborts++;
+    }
+    return 0;
+}
+
+// Every thread reserves seats of its own row of a shared event, and shows
+// the whole event every eighth operation
+static void setup_mix() { ems_create(1, num_threads, num_ops); }
+
+static int op_mix(struct BenchThread *thread, size_t i) {
+    if (i % 8 == 0) {
+        return ems_show(1, null_fd);
+    }
+    if (reserve_seat(1, thread->id + 1, i + 1) != 0) {
+        thread->aborts++;
+    }
+    return 0;
+}
+
+static const struct Pattern patterns[] = {
+    {"hotspot", "same seat", setup_hotspot, op_hotspot},
+    {"samerow", "same row", setup_samerow, op_samerow},
+    {"disjoint", "one event per thread", setup_disjoint, op_disjoint},
+    {"mix", "SHOW vs RESERVE", setup_mix, op_mix},
+};
+
+static const struct Pattern *current_pattern = NULL;
+
+/// Runs the operations of one thread.
+static void *run_thread(void *arg) {
+    struct BenchThread *thread = (struct BenchThread *)arg;
+    for (size_t i = 0; i < num_ops; i++) {
+        uint64_t start = clock_ns();
+        current_pattern->op(thread, i);
+        thread->latencies[i] = clock_ns() - start;
+    }
+    return NULL;
+}
+
+static int compare_latencies(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/// Runs a pattern and prints its results.
+/// @return 0 if the pattern ran successfully, 1 otherwise.
+static int run_pattern(const struct Pattern *pattern) {
+    reset_event_list();
+    pattern->setup();
+    current_pattern = pattern;
+
+    struct BenchThread *threads = calloc(num_threads, sizeof(*threads));
+    uint64_t *latencies = malloc((size_t)num_threads * num_ops *
+                                 sizeof(uint64_t));
+    if (threads == NULL || latencies == NULL) {
+        fprintf(stderr, "Error allocating memory for the benchmark\n");
+        free(threads);
+        free(latencies);
+        return 1;
+    }
+
+    // Failed reservations report errors on stderr, which would dominate
+    fflush(stderr);
+    int stderr_fd = dup(STDERR_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+
+    uint64_t start = clock_ns();
+    unsigned int started = 0;
+    for (; started < num_threads; started++) {
+        threads[started].id = started;
+        threads[started].seed = started + 1;
+        threads[started].latencies = latencies + (size_t)started * num_ops;
+        if (pthread_create(&threads[started].thread, NULL, run_thread,
+                           &threads[started]) != 0) {
+            break;
+        }
+    }
+
+    size_t aborts = 0, retries = 0;
+    for (unsigned int t = 0; t < started; t++) {
+        pthread_join(threads[t].thread, NULL);
+        aborts += threads[t].aborts;
+        retries += threads[t].retries;
+    }
+    uint64_t elapsed = clock_ns() - start;
+
+    dup2(stderr_fd, STDERR_FILENO);
+    close(stderr_fd);
+
+    if (started < num_threads) {
+        fprintf(stderr, "Error creating thread\n");
+        free(threads);
+        free(latencies);
+        return 1;
+    }
+
+    size_t total = (size_t)num_threads * num_ops;
+    qsort(latencies, total, sizeof(uint64_t), compare_latencies);
+
+    printf("%-9s %-21s %8.0f %9.2f %9.2f %9zu %9zu\n", pattern->name,
+           pattern->description, (double)total * 1e9 / (double)elapsed,
+           (double)latencies[total / 2] / 1000.0,
+           (double)latencies[total * 99 / 100] / 1000.0, aborts, retries);
+
+    free(threads);
+    free(latencies);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:")) != -1) {
+        switch (opt) {
+        case 't':
+            num_threads = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            num_ops = (size_t)strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-t threads] [-n ops_per_thread] "
+                    "[hotspot|samerow|disjoint|mix ...]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if (num_threads == 0 || num_ops == 0) {
+        fprintf(stderr, "Threads and operations must be positive\n");
+        return 1;
+    }
+
+    size_t num_patterns = sizeof(patterns) / sizeof(patterns[0]);
+    for (int j = optind; j < argc; j++) {
+        size_t i = 0;
+        while (i < num_patterns && strcmp(argv[j], patterns[i].name) != 0) {
+            i++;
+        }
+        if (i == num_patterns) {
+            fprintf(stderr, "Unknown pattern: %s\n", argv[j]);
+            return 1;
+        }
+    }
+
+    null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd == -1) {
+        perror("Error opening /dev/null");
+        return 1;
+    }
+
+    // Measure synchronization only
+    if (ems_init(0)) {
+        fprintf(stderr, "Failed to initialize EMS\n");
+        return 1;
+    }
+
+    printf("%u threads, %zu operations per thread\n", num_threads, num_ops);
+    printf("%-9s %-21s %8s %9s %9s %9s %9s\n", "pattern", "access", "ops/s",
+           "p50 (us)", "p99 (us)", "aborts", "retries");
+
+    int result = 0;
+    for (size_t i = 0; i < num_patterns; i++) {
+        // Run every pattern, or only the ones named on the command line
+        int selected = optind == argc;
+        for (int j = optind; j < argc; j++) {
+            selected |= strcmp(argv[j], patterns[i].name) == 0;
+        }
+
+        if (selected) {
+            result |= run_pattern(&patterns[i]);
+        }
+    }
+
+    ems_terminate();
+    close(null_fd);
+    return result;
+}
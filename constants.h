@@ -1,3 +1,14 @@
-#define MAX_RESERVATION_SIZE 256
 #define STATE_ACCESS_DELAY_MS 10
 #define PATH_MAX        4096
+#define TILE_ROWS 8
+#define TILE_COLS 64
+#define WAL_BATCH_BYTES 65536
+#define WORKER_STACK_SIZE (256 * 1024)
+#define TRACE_RING_EVENTS 16384
+#define TRACE_MIN_WAIT_NS 1000
+#define READAHEAD_FILES 2
+#define SHOW_RECORD_MARKER 0x00
+#define SHOW_RECORD_TYPE 0x53
+#define COMMAND_BATCH_MAX 64
+#define EVENT_CACHE_SIZE 8
+#define AUTO_SAMPLE_BYTES (1024 * 1024)
@@ -0,0 +1,244 @@
+#include "contention.h"
+#include "memio.h"
+#include "memory.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/// A contended row or seat, as reported.
+struct HotSpot {
+    size_t row;
+    size_t col; // 0 for a whole row.
+    unsigned int waits;
+    unsigned int conflicts;
+};
+
+static size_t report_top = 0;
+
+void contention_configure(size_t top) { report_top = top; }
+
+size_t contention_top() { return report_top; }
+
+// Size of the structure, its row counters and the pointers to seat counters
+size_t contention_memory(size_t rows) {
+    size_t per_row = sizeof(struct SeatContention) +
+                     sizeof(struct SeatContention *);
+    size_t total;
+    if (__builtin_mul_overflow(rows ? rows : 1, per_row, &total) ||
+        __builtin_add_overflow(total, sizeof(struct Contention), &total)) {
+        return SIZE_MAX;
+    }
+    return total;
+}
+
+// Allocate the row counters, the seat counters are allocated on demand
+struct Contention *contention_create(size_t rows, size_t cols) {
+    struct Contention *contention = malloc(sizeof(struct Contention));
+    if (contention == NULL) {
+        return NULL;
+    }
+
+    contention->rows = rows;
+    contention->cols = cols;
+    atomic_init(&contention->memory, 0);
+    contention->row_counts =
+        calloc(rows ? rows : 1, sizeof(struct SeatContention));
+    contention->seat_counts =
+        calloc(rows ? rows : 1, sizeof(struct SeatContention *));
+
+    if (contention->row_counts == NULL || contention->seat_counts == NULL) {
+        contention_free(contention);
+        return NULL;
+    }
+    return contention;
+}
+
+void contention_free(struct Contention *contention) {
+    if (contention == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; contention->seat_counts && i < contention->rows; i++) {
+        free(contention->seat_counts[i]);
+    }
+    free(contention->seat_counts);
+    free(contention->row_counts);
+    memory_release(atomic_load(&contention->memory));
+    free(contention);
+}
+
+/// Gets the counters of a seat, allocating those of its row on first use.
+/// @return Pointer to the counters, NULL if they could not be allocated or
+/// do not fit in the memory budget, in which case only the row is counted.
+static struct SeatContention *get_seat(struct Contention *contention,
+                                       size_t row, size_t col) {
+    struct SeatContention *seats = atomic_load_explicit(
+        &contention->seat_counts[row - 1], memory_order_acquire);
+
+    if (seats == NULL) {
+        size_t size = contention->cols * sizeof(struct SeatContention);
+        if (memory_charge(size) != 0) {
+            return NULL;
+        }
+        struct SeatContention *created =
+            calloc(contention->cols, sizeof(struct SeatContention));
+        if (created == NULL) {
+            memory_release(size);
+            return NULL;
+        }
+
+        // Another thread may have allocated them in the meantime
+        if (atomic_compare_exchange_strong(&contention->seat_counts[row - 1],
+                                           &seats, created)) {
+            seats = created;
+            atomic_fetch_add(&contention->memory, size);
+        } else {
+            free(created);
+            memory_release(size);
+        }
+    }
+
+    return &seats[col - 1];
+}
+
+void contention_record_wait(struct Contention *contention, size_t row,
+                            size_t col) {
+    atomic_fetch_add_explicit(&contention->row_counts[row - 1].waits, 1,
+                              memory_order_relaxed);
+
+    struct SeatContention *seat = get_seat(contention, row, col);
+    if (seat != NULL) {
+        atomic_fetch_add_explicit(&seat->waits, 1, memory_order_relaxed);
+    }
+}
+
+void contention_record_conflict(struct Contention *contention, size_t row,
+                                size_t col) {
+    atomic_fetch_add_explicit(&contention->row_counts[row - 1].conflicts, 1,
+                              memory_order_relaxed);
+
+    struct SeatContention *seat = get_seat(contention, row, col);
+    if (seat != NULL) {
+        atomic_fetch_add_explicit(&seat->conflicts, 1, memory_order_relaxed);
+    }
+}
+
+/// Orders hot spots from the most to the least contended, and then by
+/// position.
+static int compare_hot_spots(const void *a, const void *b) {
+    const struct HotSpot *spot_a = a, *spot_b = b;
+    size_t total_a = (size_t)spot_a->waits + spot_a->conflicts;
+    size_t total_b = (size_t)spot_b->waits + spot_b->conflicts;
+    if (total_a != total_b) {
+        return total_a > total_b ? -1 : 1;
+    }
+    if (spot_a->row != spot_b->row) {
+        return spot_a->row < spot_b->row ? -1 : 1;
+    }
+    return (spot_a->col > spot_b->col) - (spot_a->col < spot_b->col);
+}
+
+/// Adds a row or seat to the hot spots if it was contended.
+static void add_hot_spot(struct HotSpot *spots, size_t *num_spots, size_t row,
+                         size_t col, const struct SeatContention *counts) {
+    unsigned int waits = atomic_load(&counts->waits);
+    unsigned int conflicts = atomic_load(&counts->conflicts);
+    if (waits != 0 || conflicts != 0) {
+        spots[(*num_spots)++] = (struct HotSpot){row, col, waits, conflicts};
+    }
+}
+
+/// Writes the most contended of some hot spots.
+static void write_hot_spots(int fd, const char *title, struct HotSpot *spots,
+                            size_t num_spots) {
+    if (num_spots == 0) {
+        return;
+    }
+
+    qsort(spots, num_spots, sizeof(struct HotSpot), compare_hot_spots);
+
+    char buffer[128];
+    int length = snprintf(buffer, sizeof(buffer), "%s:\n", title);
+    io_write(fd, buffer, (size_t)length);
+
+    for (size_t i = 0; i < num_spots && i < report_top; i++) {
+        if (spots[i].col == 0) {
+            length = snprintf(buffer, sizeof(buffer),
+                              "  Row %zu: %u waits, %u conflicts\n",
+                              spots[i].row, spots[i].waits,
+                              spots[i].conflicts);
+        } else {
+            length = snprintf(buffer, sizeof(buffer),
+                              "  Seat (%zu,%zu): %u waits, %u conflicts\n",
+                              spots[i].row, spots[i].col, spots[i].waits,
+                              spots[i].conflicts);
+        }
+        io_write(fd, buffer, (size_t)length);
+    }
+}
+
+// Report the totals of an event and its hot rows and seats
+int contention_report(struct Contention *contention, unsigned int event_id,
+                      int fd) {
+    // Gather the contended rows and their totals
+    struct HotSpot *rows =
+        malloc((contention->rows ? contention->rows : 1) *
+               sizeof(struct HotSpot));
+    if (rows == NULL) {
+        fprintf(stderr, "Error allocating memory for contention report\n");
+        return 1;
+    }
+
+    size_t num_rows = 0, num_seats = 0, waits = 0, conflicts = 0;
+    for (size_t row = 1; row <= contention->rows; row++) {
+        add_hot_spot(rows, &num_rows, row, 0, &contention->row_counts[row - 1]);
+        if (atomic_load(&contention->seat_counts[row - 1]) != NULL) {
+            num_seats += contention->cols;
+        }
+    }
+    for (size_t i = 0; i < num_rows; i++) {
+        waits += rows[i].waits;
+        conflicts += rows[i].conflicts;
+    }
+
+    // Events nobody contended are left out
+    if (num_rows == 0) {
+        free(rows);
+        return 0;
+    }
+
+    // Gather the contended seats of the rows that have seat counters
+    size_t capacity = num_seats;
+    struct HotSpot *seats =
+        malloc((capacity ? capacity : 1) * sizeof(struct HotSpot));
+    if (seats == NULL) {
+        fprintf(stderr, "Error allocating memory for contention report\n");
+        free(rows);
+        return 1;
+    }
+
+    num_seats = 0;
+    for (size_t row = 1; row <= contention->rows; row++) {
+        struct SeatContention *counts =
+            atomic_load(&contention->seat_counts[row - 1]);
+        if (counts == NULL || capacity - num_seats < contention->cols) {
+            continue; // Rows contended since they were counted are left out
+        }
+        for (size_t col = 1; col <= contention->cols; col++) {
+            add_hot_spot(seats, &num_seats, row, col, &counts[col - 1]);
+        }
+    }
+
+    char buffer[128];
+    int length = snprintf(buffer, sizeof(buffer),
+                          "Event %u: %zu waits, %zu conflicts\n", event_id,
+                          waits, conflicts);
+    io_write(fd, buffer, (size_t)length);
+
+    write_hot_spots(fd, "Hot rows", rows, num_rows);
+    write_hot_spots(fd, "Hot seats", seats, num_seats);
+
+    free(rows);
+    free(seats);
+    return 0;
+}
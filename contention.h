@@ -0,0 +1,66 @@
+#ifndef EMS_CONTENTION_H
+#define EMS_CONTENTION_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/// Contention of a seat, or of a whole row.
+struct SeatContention {
+    atomic_uint waits;     // Times a seat lock was found taken.
+    atomic_uint conflicts; // Reservations that failed on a taken seat.
+};
+
+/// Contention counters of the seats of an event. Rows are counted from the
+/// start, and the seats of a row once it is first contended, so an event
+/// nobody fights over only costs its row counters. Both are accounted
+/// against the memory budget: the row counters by the event that creates
+/// them, the seat counters here, as they are allocated.
+struct Contention {
+    size_t rows;
+    size_t cols;
+    struct SeatContention *row_counts;            // Totals of each row.
+    struct SeatContention *_Atomic *seat_counts; // Seats of each row, NULL
+                                                 // until the row is contended.
+    atomic_size_t memory;                        // Bytes of seat counters.
+};
+
+/// Enables contention counters for the events created from now on.
+/// @param top Number of rows and seats reported, 0 to disable the counters.
+void contention_configure(size_t top);
+
+/// Returns the number of rows and seats reported, 0 if disabled.
+size_t contention_top();
+
+/// Gets the number of bytes contention_create() allocates.
+/// @param rows Number of rows of the event.
+/// @return Size of the counters, SIZE_MAX if it does not fit in a size_t.
+size_t contention_memory(size_t rows);
+
+/// Creates the counters of an event. Their memory, as given by
+/// contention_memory(), is accounted by the caller.
+/// @param rows Number of rows of the event.
+/// @param cols Number of columns of the event.
+/// @return Newly created counters, NULL on failure.
+struct Contention *contention_create(size_t rows, size_t cols);
+
+/// Destroys the counters of an event, releasing the seat counters from the
+/// memory budget.
+void contention_free(struct Contention *contention);
+
+/// Records a wait for the lock of a seat.
+void contention_record_wait(struct Contention *contention, size_t row,
+                            size_t col);
+
+/// Records a reservation that failed because a seat was taken.
+void contention_record_conflict(struct Contention *contention, size_t row,
+                                size_t col);
+
+/// Writes the totals of an event and its most contended rows and seats.
+/// @param contention Counters of the event.
+/// @param event_id Id of the event.
+/// @param fd File descriptor to write to.
+/// @return 0 if the report was written successfully, 1 otherwise.
+int contention_report(struct Contention *contention, unsigned int event_id,
+                      int fd);
+
+#endif // EMS_CONTENTION_H
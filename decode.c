@@ -0,0 +1,145 @@
+/*
+Decoder for the binary SHOW output of ems -f binary.
+Copies an output file to the standard output, replacing every binary SHOW
+record with the text SHOW prints in the text format, so decoded output can be
+compared with the expected results.
+
+Usage: ./ems-decode [file]
+*/
+
+#include "constants.h"
+#include "varint.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Reads a whole stream.
+/// @param file Stream to read.
+/// @param len Set to the number of bytes read.
+/// @return Newly allocated contents, NULL on failure.
+static unsigned char *read_all(FILE *file, size_t *len) {
+    size_t cap = 65536, used = 0;
+    unsigned char *data = malloc(cap);
+    while (data != NULL) {
+        used += fread(data + used, 1, cap - used, file);
+        if (used < cap) {
+            break;
+        }
+
+        cap *= 2;
+        unsigned char *grown = realloc(data, cap);
+        if (grown == NULL) {
+            free(data);
+        }
+        data = grown;
+    }
+
+    if (data == NULL) {
+        fprintf(stderr, "Error allocating memory for input\n");
+        return NULL;
+    }
+    if (ferror(file)) {
+        perror("Error reading input");
+        free(data);
+        return NULL;
+    }
+
+    *len = used;
+    return data;
+}
+
+/// Prints a binary SHOW record as text.
+/// @param in Pointer to the record, after its marker and type, advanced past
+/// its end.
+/// @param end End of the input.
+/// @return 0 if the record was printed, 1 if it is malformed.
+static int decode_record(const unsigned char **in, const unsigned char *end) {
+    uint64_t event_id, rows, cols;
+    if (get_varint(in, end, &event_id) || get_varint(in, end, &rows) ||
+        get_varint(in, end, &cols)) {
+        return 1;
+    }
+
+    // An event with no columns still prints an empty line per row
+    if (cols == 0) {
+        for (uint64_t i = 0; i < rows; i++) {
+            putchar('\n');
+        }
+        return 0;
+    }
+
+    if (rows > UINT64_MAX / cols) {
+        return 1;
+    }
+
+    uint64_t seats = rows * cols, seat = 0;
+    while (seat < seats) {
+        uint64_t reservation_id, length;
+        if (get_varint(in, end, &reservation_id) ||
+            get_varint(in, end, &length) || reservation_id > UINT32_MAX ||
+            length == 0 || length > seats - seat) {
+            return 1;
+        }
+
+        for (uint64_t i = 0; i < length; i++, seat++) {
+            printf("%u ", (unsigned int)reservation_id);
+            if ((seat + 1) % cols == 0) {
+                putchar('\n');
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [file]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = stdin;
+    if (argc == 2) {
+        file = fopen(argv[1], "rb");
+        if (file == NULL) {
+            perror("Error opening input");
+            return 1;
+        }
+    }
+
+    size_t len;
+    unsigned char *data = read_all(file, &len);
+    if (file != stdin) {
+        fclose(file);
+    }
+    if (data == NULL) {
+        return 1;
+    }
+
+    // Text is copied as is up to the next record
+    const unsigned char *in = data, *end = data + len;
+    int result = 0;
+    while (in < end) {
+        const unsigned char *marker = memchr(in, SHOW_RECORD_MARKER,
+                                             (size_t)(end - in));
+        if (marker == NULL) {
+            marker = end;
+        }
+        fwrite(in, 1, (size_t)(marker - in), stdout);
+        if (marker == end) {
+            break;
+        }
+
+        in = marker + 1;
+        if (in == end || *in++ != SHOW_RECORD_TYPE ||
+            decode_record(&in, end) != 0) {
+            fprintf(stderr, "Invalid SHOW record at byte %zu\n",
+                    (size_t)(marker - data));
+            result = 1;
+            break;
+        }
+    }
+
+    free(data);
+    return result;
+}
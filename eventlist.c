@@ -1,4 +1,5 @@
 #include "eventlist.h"
+#include "memory.h"
 
 #include <stdlib.h>
 
@@ -35,14 +36,47 @@ int append_to_list(struct EventList *list, struct Event *event) {
     return 0;
 }
 
-static void free_event(struct Event *event) {
+size_t reservation_size(size_t num_spans) {
+    return sizeof(struct Reservation) + num_spans * sizeof(struct SeatSpan);
+}
+
+void free_event(struct Event *event) {
     if (!event)
         return;
-    // Destroy seat mutexes
-    for (size_t i = 0; i < event->rows * event->cols; i++) {
-        pthread_mutex_destroy(&event->mutexes[i]);
+    // Destroy seat mutexes of the allocated tiles
+    for (size_t i = 0; event->tiles && i < event->num_tiles; i++) {
+        struct SeatTile *tile = event->tiles[i];
+        if (tile == NULL) {
+            continue;
+        }
+        for (size_t j = 0; j < TILE_ROWS * TILE_COLS; j++) {
+            pthread_mutex_destroy(&tile->mutexes[j]);
+        }
+        free(tile);
+    }
+    free(event->tiles);
+    for (size_t i = 0; event->row_index && i < event->rows; i++) {
+        row_index_free(event->row_index[i]);
+    }
+    free(event->row_index);
+    for (size_t i = 0; i < event->reservation_seats_cap; i++) {
+        struct Reservation *reservation = event->reservation_seats[i];
+        if (reservation != NULL) {
+            memory_release(reservation_size(reservation->num_spans));
+            free(reservation);
+        }
     }
-    free(event->data);
+    memory_release(event->reservation_seats_cap *
+                   sizeof(struct Reservation *));
+    free(event->reservation_seats);
+    free(event->dirty_rows);
+    free(event->reserved_rows);
+    memory_release(event->show_output.cap);
+    free(event->show_output.data);
+    contention_free(event->contention);
+    pthread_mutex_destroy(&event->tile_lock);
+    pthread_rwlock_destroy(&event->lock);
+    memory_release(event->memory);
     free(event);
 }
 
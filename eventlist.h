@@ -1,20 +1,79 @@
 #ifndef EVENT_LIST_H
 #define EVENT_LIST_H
 
+#include "constants.h"
+#include "contention.h"
+#include "operations.h"
+#include "rowindex.h"
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/// Block of TILE_ROWS x TILE_COLS seats. Tiles are only allocated when a
+/// reservation first touches them; the seats of a missing tile are free.
+struct SeatTile {
+    unsigned int data[TILE_ROWS * TILE_COLS]; // Reservation of each seat.
+    pthread_mutex_t mutexes[TILE_ROWS * TILE_COLS]; // Mutex of each seat.
+    atomic_uint_least64_t booked[TILE_ROWS]; // Bitmap of the taken seats of
+                                             // each row of the tile.
+};
+
+/// Growable buffer that output is rendered into.
+struct Output {
+    char *data; // Rendered bytes.
+    size_t len; // Number of rendered bytes.
+    size_t cap; // Capacity of data.
+};
+
+/// Seats of a reservation, kept so that it can be cancelled.
+struct Reservation {
+    size_t num_spans;         // Number of spans.
+    struct SeatSpan spans[]; // Spans sorted by row and column.
+};
 
 struct Event {
     unsigned int id;           /// Event id
-    unsigned int reservations; /// Number of reservations for the event.
+    atomic_uint reservations; /// Number of reservations for the event,
+                              /// written under reservation_id_lock.
+    atomic_size_t booked_seats; /// Number of taken seats.
 
     size_t cols; /// Number of columns.
     size_t rows; /// Number of rows.
 
-    unsigned int
-        *data; // Array of size rows * cols with the reservations for each seat.
-    pthread_mutex_t *mutexes; // Array of size rows * cols with the mutexes for
-                              // each seat.
+    size_t tile_cols; /// Number of tiles in each row of tiles.
+    size_t num_tiles; /// Number of tiles covering the event.
+
+    struct SeatTile *_Atomic *tiles; // Array of num_tiles tiles, in row
+                                     // major order. NULL until allocated.
+    pthread_mutex_t tile_lock;       // Serializes tile allocation.
+    size_t memory; // Bytes accounted for the event, protected by tile_lock.
+
+    struct RowIndex *_Atomic *row_index; // Array of rows free run indexes.
+                                         // NULL until RESERVE_BEST scans
+                                         // the row.
+
+    struct Reservation **reservation_seats; // Seats of each reservation, by
+                                            // id. NULL once cancelled.
+    size_t reservation_seats_cap; // Capacity of reservation_seats. Both are
+                                  // accounted apart from memory.
+
+    int home_cpu;  /// CPU of the thread that created the event.
+    int home_node; /// NUMA node of the thread that created the event.
+
+    atomic_uint version; // Incremented whenever a seat changes.
+    struct Output show_output; // Last rendered SHOW output, protected by lock
+                               // and accounted apart from memory.
+    unsigned int show_output_version; // Version show_output was rendered at.
+
+    atomic_uint_least64_t *dirty_rows; // Bitmap of the rows changed since the
+                                       // event was last shown.
+    atomic_uint_least64_t *reserved_rows; // Bitmap of the rows that ever had
+                                          // seats reserved.
+    pthread_rwlock_t lock; // Held for reading while seats are reserved and for
+                           // writing while the whole event is read.
+
+    struct Contention *contention; // Contention counters, NULL if disabled.
 };
 
 struct ListNode {
@@ -38,6 +97,15 @@ struct EventList *create_list();
 /// @return 0 if the node was appended successfully, 1 otherwise.
 int append_to_list(struct EventList *list, struct Event *data);
 
+/// Gets the number of bytes of the copy of a reservation.
+/// @param num_spans Number of spans of the reservation.
+size_t reservation_size(size_t num_spans);
+
+/// Destroys an event and everything it has allocated, releasing it from the
+/// memory budget. Arrays that failed to be allocated may be NULL.
+/// @param event Event to be destroyed.
+void free_event(struct Event *event);
+
 /// Removes a node from the list.
 /// @param list Event list to be modified.
 /// @return 0 if the node was removed successfully, 1 otherwise.
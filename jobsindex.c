@@ -0,0 +1,189 @@
+#include "jobsindex.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// A chunk of the file and the lines found in it.
+struct Chunk {
+    pthread_t thread;
+    int threaded;         // Whether the chunk is scanned by its own thread.
+    const char *data;     // Whole file.
+    size_t from;          // First byte of the chunk, at the start of a line.
+    size_t to;            // End of the chunk, at the start of a line.
+    size_t num_lines;     // Lines starting in the chunk.
+    size_t num_global;    // Global lines starting in the chunk.
+    size_t line_base;     // Index of the chunk's first line in the file.
+    size_t global_base;   // Index of the chunk's first global line.
+    struct JobsIndex *index; // Index to fill, NULL to only count the lines.
+};
+
+/// Returns whether every thread runs a line: WAIT applies to all threads and
+/// BARRIER stops all of them.
+static int is_global_line(char first) { return first == 'W' || first == 'B'; }
+
+/// Counts the lines of a chunk or, once the bases are known, records them.
+static void *scan_chunk(void *arg) {
+    struct Chunk *chunk = (struct Chunk *)arg;
+    size_t line = chunk->line_base, global = chunk->global_base;
+
+    size_t start = chunk->from;
+    while (start < chunk->to) {
+        int global_line = is_global_line(chunk->data[start]);
+        if (chunk->index != NULL) {
+            chunk->index->line_starts[line] = (off_t)start;
+            if (global_line) {
+                chunk->index->global_lines[global] = line;
+            }
+        }
+        line++;
+        global += (size_t)global_line;
+
+        const char *newline =
+            memchr(chunk->data + start, '\n', chunk->to - start);
+        if (newline == NULL) {
+            break;
+        }
+        start = (size_t)(newline - chunk->data) + 1;
+    }
+
+    chunk->num_lines = line - chunk->line_base;
+    chunk->num_global = global - chunk->global_base;
+    return NULL;
+}
+
+/// Runs scan_chunk on every chunk, one thread each.
+static void scan_chunks(struct Chunk *chunks, size_t num_chunks) {
+    for (size_t i = 1; i < num_chunks; i++) {
+        chunks[i].threaded = pthread_create(&chunks[i].thread, NULL,
+                                            scan_chunk, &chunks[i]) == 0;
+        if (!chunks[i].threaded) {
+            // Scan it on the calling thread instead
+            scan_chunk(&chunks[i]);
+        }
+    }
+
+    scan_chunk(&chunks[0]);
+
+    for (size_t i = 1; i < num_chunks; i++) {
+        if (chunks[i].threaded) {
+            pthread_join(chunks[i].thread, NULL);
+        }
+    }
+}
+
+// Index the lines of a .jobs file
+int jobs_index_build(const char *path, size_t num_chunks,
+                     struct JobsIndex *index) {
+    *index = (struct JobsIndex){NULL, 0, NULL, 0};
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror("Error opening job file");
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("Error reading job file");
+        close(fd);
+        return 1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mapping job file");
+        return 1;
+    }
+
+    int result = jobs_index_build_buffer(data, size, num_chunks, index);
+    munmap(data, size);
+    return result;
+}
+
+// Index the lines of commands in memory
+int jobs_index_build_buffer(const char *data, size_t size, size_t num_chunks,
+                            struct JobsIndex *index) {
+    *index = (struct JobsIndex){NULL, 0, NULL, 0};
+    if (size == 0) {
+        return 0;
+    }
+
+    if (num_chunks == 0) {
+        num_chunks = 1;
+    }
+    if (num_chunks > size) {
+        num_chunks = size;
+    }
+
+    struct Chunk *chunks = calloc(num_chunks, sizeof(struct Chunk));
+    if (chunks == NULL) {
+        fprintf(stderr, "Error allocating memory for job file index\n");
+        return 1;
+    }
+
+    // Split the file in chunks of about the same size, moving each boundary
+    // to the start of the next line
+    size_t from = 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        size_t to = size;
+        if (i + 1 < num_chunks) {
+            to = size / num_chunks * (i + 1);
+            if (to <= from) {
+                to = from;
+            } else {
+                const char *newline = memchr(data + to - 1, '\n', size - to + 1);
+                to = newline != NULL ? (size_t)(newline - data) + 1 : size;
+            }
+        }
+
+        chunks[i] = (struct Chunk){0, 0, data, from, to, 0, 0, 0, 0, NULL};
+        from = to;
+    }
+
+    // Count the lines of every chunk in parallel
+    scan_chunks(chunks, num_chunks);
+
+    // A prefix sum of the counts gives the first line of every chunk
+    for (size_t i = 0; i < num_chunks; i++) {
+        chunks[i].line_base = index->num_lines;
+        chunks[i].global_base = index->num_global;
+        index->num_lines += chunks[i].num_lines;
+        index->num_global += chunks[i].num_global;
+    }
+
+    index->line_starts = malloc((index->num_lines + 1) * sizeof(off_t));
+    index->global_lines = malloc((index->num_global + 1) * sizeof(size_t));
+    int result = 0;
+    if (index->line_starts == NULL || index->global_lines == NULL) {
+        fprintf(stderr, "Error allocating memory for job file index\n");
+        jobs_index_free(index);
+        result = 1;
+    } else {
+        // Record the lines of every chunk in parallel, at their final place
+        for (size_t i = 0; i < num_chunks; i++) {
+            chunks[i].index = index;
+        }
+        scan_chunks(chunks, num_chunks);
+    }
+
+    free(chunks);
+    return result;
+}
+
+void jobs_index_free(struct JobsIndex *index) {
+    free(index->line_starts);
+    free(index->global_lines);
+    *index = (struct JobsIndex){NULL, 0, NULL, 0};
+}
@@ -0,0 +1,38 @@
+#ifndef EMS_JOBS_INDEX_H
+#define EMS_JOBS_INDEX_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/// Lines of a .jobs file, so that each thread can go straight to the lines it
+/// runs instead of parsing the whole file.
+struct JobsIndex {
+    off_t *line_starts;   // Offset of every line, in file order.
+    size_t num_lines;     // Number of lines.
+    size_t *global_lines; // Lines every thread runs (WAIT and BARRIER).
+    size_t num_global;    // Number of global lines.
+};
+
+/// Indexes the lines of a .jobs file. The file is split into chunks on line
+/// boundaries, which are scanned in parallel; a prefix sum of their line
+/// counts gives each chunk the absolute number of its first line.
+/// @param path Path of the .jobs file.
+/// @param num_chunks Number of chunks, and of threads scanning them.
+/// @param index Index to fill, freed with jobs_index_free().
+/// @return 0 if the file was indexed successfully, 1 otherwise.
+int jobs_index_build(const char *path, size_t num_chunks,
+                     struct JobsIndex *index);
+
+/// Indexes the lines of commands in memory, like jobs_index_build().
+/// @param data Commands, in the format of a .jobs file.
+/// @param size Number of bytes of the commands.
+/// @param num_chunks Number of chunks, and of threads scanning them.
+/// @param index Index to fill, freed with jobs_index_free().
+/// @return 0 if the commands were indexed successfully, 1 otherwise.
+int jobs_index_build_buffer(const char *data, size_t size, size_t num_chunks,
+                            struct JobsIndex *index);
+
+/// Frees an index.
+void jobs_index_free(struct JobsIndex *index);
+
+#endif // EMS_JOBS_INDEX_H
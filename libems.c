@@ -0,0 +1,75 @@
+#include "libems.h"
+#include "jobsindex.h"
+#include "memio.h"
+#include "operations.h"
+#include "parallelization.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Initialize the events and the carriers of every call
+int libems_init(unsigned int state_access_delay_ms, int num_carriers) {
+    max_carriers = num_carriers > 0 ? num_carriers
+                                    : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return ems_init(state_access_delay_ms);
+}
+
+// Run commands from memory, as a child process runs a .jobs file
+int libems_run(const char *commands, size_t length, int num_threads,
+               char *output, size_t capacity, size_t *output_length) {
+    *output_length = 0;
+    if (num_threads <= 0) {
+        fprintf(stderr, "Invalid number of threads: %d\n", num_threads);
+        return 1;
+    }
+    max_thr = num_threads;
+
+    // Find where every line starts, as for a .jobs file
+    struct JobsIndex index;
+    if (jobs_index_build_buffer(commands, length, (size_t)max_carriers,
+                                &index) != 0) {
+        return 1;
+    }
+
+    struct ThreadData *thread_list =
+        malloc((size_t)max_thr * sizeof(struct ThreadData));
+    int out_fd = memio_open_output(output, capacity);
+    if (thread_list == NULL || out_fd == -1) {
+        fprintf(stderr, "Error allocating memory for threads\n");
+        free(thread_list);
+        io_close(out_fd);
+        jobs_index_free(&index);
+        return 1;
+    }
+
+    // Every thread reads the commands through its own stream
+    int result = 0;
+    for (int i = 0; i < max_thr; ++i) {
+        int fd = memio_open_input(commands, length);
+        result |= fd == -1;
+        init_thread(&thread_list[i], i + 1, fd, out_fd, &index);
+    }
+
+    if (result == 0) {
+        result = process_jobs(thread_list);
+    }
+
+    // Close the streams of the threads that did not reach the end
+    for (int i = 0; i < max_thr; ++i) {
+        if (thread_list[i].fd != -1) {
+            io_close(thread_list[i].fd);
+        }
+    }
+
+    *output_length = memio_length(out_fd);
+    if (*output_length > capacity) {
+        result = 1;
+    }
+
+    io_close(out_fd);
+    free(thread_list);
+    jobs_index_free(&index);
+    return result;
+}
+
+int libems_terminate() { return ems_terminate(); }
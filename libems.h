@@ -0,0 +1,34 @@
+#ifndef EMS_LIBEMS_H
+#define EMS_LIBEMS_H
+
+#include <stddef.h>
+
+/// Interface of libems, which runs EMS inside the calling process. Commands
+/// are read from and results written to the caller's buffers, with no files
+/// or child processes. Events persist across calls until libems_terminate().
+/// Calls must not overlap.
+
+/// Initializes the events of the calling process.
+/// @param state_access_delay_ms Delay of every state access in milliseconds.
+/// @param num_carriers Number of OS threads that run the logical threads of
+/// a call, 0 for one per online CPU.
+/// @return 0 if EMS was initialized successfully, 1 otherwise.
+int libems_init(unsigned int state_access_delay_ms, int num_carriers);
+
+/// Runs commands, as in a .jobs file, on the events.
+/// @param commands Commands, one per line.
+/// @param length Number of bytes of the commands.
+/// @param num_threads Number of logical threads running the commands.
+/// @param output Buffer the results are written into, as in a .out file.
+/// @param capacity Number of bytes of the buffer.
+/// @param output_length Set to the number of bytes of the results, more than
+/// the capacity if they did not fit, in which case they are truncated.
+/// @return 0 if the commands ran and their results fit, 1 otherwise.
+int libems_run(const char *commands, size_t length, int num_threads,
+               char *output, size_t capacity, size_t *output_length);
+
+/// Frees the events.
+/// @return 0 if EMS was terminated successfully, 1 otherwise.
+int libems_terminate();
+
+#endif // EMS_LIBEMS_H
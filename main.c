@@ -9,21 +9,143 @@ Description:
     ensuring atomic operations by locking the output file and seats.
 */
 
+#include "affinity.h"
+#include "autoconfig.h"
 #include "constants.h"
+#include "contention.h"
+#include "memory.h"
 #include "operations.h"
 #include "parallelization.h"
+#include "trace.h"
+#include "vclock.h"
+#include "wal.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-int max_thr = 1;
-int max_proc =1;
+/// Parses a positive decimal number, such as the value of an option.
+/// @param str Argument to parse.
+/// @param max Largest value accepted.
+/// @param value Set to the number.
+/// @return 0 if the argument is valid, 1 otherwise.
+static int parse_positive(const char *str, unsigned long max,
+                          unsigned long *value) {
+    char *endptr;
+    errno = 0;
+    unsigned long number = strtoul(str, &endptr, 10);
+    if (errno != 0 || endptr == str || *endptr != '\0' || str[0] < '0' ||
+        str[0] > '9' || number == 0 || number > max) {
+        return 1;
+    }
+
+    *value = number;
+    return 0;
+}
+
+/// Parses a process or thread count: a positive number, or "auto" to let
+/// auto_configure() choose it.
+/// @param str Argument to parse.
+/// @param count Set to the count, 0 for auto.
+/// @return 0 if the argument is valid, 1 otherwise.
+static int parse_count(const char *str, int *count) {
+    if (strcmp(str, "auto") == 0) {
+        *count = 0;
+        return 0;
+    }
+
+    unsigned long value;
+    if (parse_positive(str, INT_MAX, &value) != 0) {
+        return 1;
+    }
+
+    *count = (int)value;
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
     unsigned int state_access_delay_ms = STATE_ACCESS_DELAY_MS;
+    unsigned int wal_interval_ms = 0;
+    size_t wal_batch_bytes = WAL_BATCH_BYTES;
+    unsigned long value;
+    char *cpu_list = NULL;
+    char *placement = NULL;
+
+    // Parse the options
+    int opt;
+    while ((opt = getopt(argc, argv, "w:b:c:a:p:tm:f:vH:")) != -1) {
+        switch (opt) {
+        case 'w':
+            if (parse_positive(optarg, UINT_MAX, &value) != 0) {
+                fprintf(stderr, "Invalid commit interval: %s\n", optarg);
+                return 1;
+            }
+            wal_interval_ms = (unsigned int)value;
+            break;
+        case 'b':
+            if (parse_positive(optarg, SIZE_MAX, &value) != 0) {
+                fprintf(stderr, "Invalid commit batch size: %s\n", optarg);
+                return 1;
+            }
+            wal_batch_bytes = (size_t)value;
+            break;
+        case 'c':
+            if (parse_count(optarg, &max_carriers) != 0) {
+                fprintf(stderr, "Invalid number of carrier threads: %s\n",
+                        optarg);
+                return 1;
+            }
+            break;
+        case 'a':
+            cpu_list = optarg;
+            break;
+        case 'p':
+            placement = optarg;
+            break;
+        case 't':
+            trace_configure(1);
+            break;
+        case 'm':
+            if (parse_positive(optarg, SIZE_MAX, &value) != 0) {
+                fprintf(stderr, "Invalid memory budget: %s\n", optarg);
+                return 1;
+            }
+            memory_configure((size_t)value);
+            break;
+        case 'f':
+            if (strcmp(optarg, "binary") == 0) {
+                ems_set_show_format(SHOW_BINARY);
+            } else if (strcmp(optarg, "text") != 0) {
+                fprintf(stderr, "Invalid SHOW format: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'v':
+            vclock_configure(1);
+            break;
+        case 'H':
+            if (parse_positive(optarg, SIZE_MAX, &value) != 0) {
+                fprintf(stderr, "Invalid number of hot spots: %s\n", optarg);
+                return 1;
+            }
+            contention_configure((size_t)value);
+            break;
+        default:
+            argc = 0; // Print the usage message
+            break;
+        }
+    }
 
     // Check if the number of arguments is correct
-    if (argc != 2 && argc != 4) {
-        fprintf(stderr, "Usage: %s <directory> [max_proc] [max_thr>]\n",
+    if (argc - optind != 1 && argc - optind != 3) {
+        fprintf(stderr,
+                "Usage: %s [-w commit_interval_ms] [-b commit_batch_bytes] "
+                "[-c carrier_threads] [-a cpu_list] [-p pack|spread] [-t] "
+                "[-m memory_budget_bytes] [-f text|binary] [-v] [-H top] "
+                "<directory> [max_proc|auto] [max_thr|auto]\n",
                 argv[0]);
         return 1;
     }
@@ -32,18 +154,45 @@ int main(int argc, char *argv[]) {
     max_proc = 1;
 
     // Set the directory
-    char *directory = argv[1];
+    char *directory = argv[optind];
 
     // Check if the optional number argument is provided
-    if (argc == 4) {
-        char *endptr;
-        max_proc = (int)strtoul(argv[2], &endptr, 10);
-        max_thr = (int)strtoul(argv[3], &endptr, 10);
+    if (argc - optind == 3) {
+        if (parse_count(argv[optind + 1], &max_proc) != 0) {
+            fprintf(stderr, "Invalid number of processes: %s\n",
+                    argv[optind + 1]);
+            return 1;
+        }
+        if (parse_count(argv[optind + 2], &max_thr) != 0) {
+            fprintf(stderr, "Invalid number of threads: %s\n",
+                    argv[optind + 2]);
+            return 1;
+        }
     } else {
         max_thr = 1;
         max_proc = 1;
     }
 
+    // Choose the counts given as auto
+    if ((max_proc == 0 || max_thr == 0) &&
+        auto_configure(directory, &max_proc, &max_thr) != 0) {
+        return 1;
+    }
+
+    // Run the logical workers on one carrier thread per online CPU by default
+    if (max_carriers <= 0) {
+        max_carriers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    // Pin the child processes and their carriers
+    if ((cpu_list != NULL || placement != NULL) &&
+        affinity_configure(cpu_list, placement) != 0) {
+        return 1;
+    }
+
+    // Enable the write-ahead log
+    wal_configure(wal_interval_ms, wal_batch_bytes);
+
     if (ems_init(state_access_delay_ms)) {
         fprintf(stderr, "Failed to initialize EMS\n");
         return 1;
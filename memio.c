@@ -0,0 +1,153 @@
+#include "memio.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// An in-memory stream.
+struct MemStream {
+    int open;
+    int output;          // Whether the stream writes into its buffer.
+    const char *input;   // Buffer of an input stream.
+    char *data;          // Buffer of an output stream.
+    size_t capacity;     // Bytes of the buffer.
+    atomic_size_t pos;   // Read position, or bytes written.
+};
+
+static struct MemStream *streams = NULL;
+static size_t num_streams = 0;
+
+/// Returns the stream named by a descriptor, NULL for a file.
+static struct MemStream *get_stream(int fd) {
+    if (fd > -2 || (size_t)(-2 - (long)fd) >= num_streams) {
+        return NULL;
+    }
+    return &streams[-2 - fd];
+}
+
+/// Takes a free stream, growing the table when every stream is open.
+/// @return Descriptor of the stream, -1 on failure.
+static int open_stream() {
+    for (size_t i = 0; i < num_streams; i++) {
+        if (!streams[i].open) {
+            streams[i].open = 1;
+            return -2 - (int)i;
+        }
+    }
+
+    size_t cap = num_streams ? num_streams * 2 : 16;
+    struct MemStream *grown = realloc(streams, cap * sizeof(struct MemStream));
+    if (grown == NULL) {
+        fprintf(stderr, "Error allocating memory for stream\n");
+        return -1;
+    }
+    memset(grown + num_streams, 0,
+           (cap - num_streams) * sizeof(struct MemStream));
+    streams = grown;
+
+    int fd = -2 - (int)num_streams;
+    streams[num_streams].open = 1;
+    num_streams = cap;
+    return fd;
+}
+
+int memio_open_input(const char *data, size_t length) {
+    int fd = open_stream();
+    if (fd != -1) {
+        struct MemStream *stream = get_stream(fd);
+        stream->output = 0;
+        stream->input = data;
+        stream->data = NULL;
+        stream->capacity = length;
+        atomic_store(&stream->pos, 0);
+    }
+    return fd;
+}
+
+int memio_open_output(char *data, size_t capacity) {
+    int fd = open_stream();
+    if (fd != -1) {
+        struct MemStream *stream = get_stream(fd);
+        stream->output = 1;
+        stream->input = NULL;
+        stream->data = data;
+        stream->capacity = capacity;
+        atomic_store(&stream->pos, 0);
+    }
+    return fd;
+}
+
+size_t memio_length(int fd) {
+    struct MemStream *stream = get_stream(fd);
+    return stream != NULL ? atomic_load(&stream->pos) : 0;
+}
+
+// Read from the position of an input stream
+ssize_t io_read(int fd, void *buf, size_t count) {
+    struct MemStream *stream = get_stream(fd);
+    if (stream == NULL) {
+        return read(fd, buf, count);
+    }
+
+    size_t pos = atomic_load_explicit(&stream->pos, memory_order_relaxed);
+    if (stream->output || pos >= stream->capacity) {
+        return 0;
+    }
+    if (count > stream->capacity - pos) {
+        count = stream->capacity - pos;
+    }
+
+    memcpy(buf, stream->input + pos, count);
+    atomic_store_explicit(&stream->pos, pos + count, memory_order_relaxed);
+    return (ssize_t)count;
+}
+
+// Append to an output stream, reserving the bytes first so that concurrent
+// writes never overlap
+ssize_t io_write(int fd, const void *buf, size_t count) {
+    struct MemStream *stream = get_stream(fd);
+    if (stream == NULL) {
+        return write(fd, buf, count);
+    }
+    if (!stream->output) {
+        return -1;
+    }
+
+    size_t pos = atomic_fetch_add(&stream->pos, count);
+    if (pos < stream->capacity) {
+        size_t fit = stream->capacity - pos;
+        memcpy(stream->data + pos, buf, count < fit ? count : fit);
+    }
+    return (ssize_t)count;
+}
+
+off_t io_seek(int fd, off_t offset, int whence) {
+    struct MemStream *stream = get_stream(fd);
+    if (stream == NULL) {
+        return lseek(fd, offset, whence);
+    }
+
+    off_t base = 0;
+    if (whence == SEEK_CUR) {
+        base = (off_t)atomic_load(&stream->pos);
+    } else if (whence == SEEK_END) {
+        base = (off_t)stream->capacity;
+    }
+    if (base + offset < 0 || stream->output) {
+        return -1;
+    }
+
+    atomic_store(&stream->pos, (size_t)(base + offset));
+    return base + offset;
+}
+
+int io_close(int fd) {
+    struct MemStream *stream = get_stream(fd);
+    if (stream == NULL) {
+        return close(fd);
+    }
+
+    stream->open = 0;
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef EMS_MEMIO_H
+#define EMS_MEMIO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/// In-memory streams, used in place of file descriptors so that the parser
+/// and the operations read commands from and write results to the caller's
+/// buffers without system calls. A stream is named by a descriptor below -1,
+/// which the io_*() functions tell apart from the descriptors of files.
+/// Streams are opened and closed while no other thread uses a stream.
+
+/// Opens a stream reading a buffer, which must outlive the stream.
+/// @param data Buffer to read.
+/// @param length Number of bytes of the buffer.
+/// @return Descriptor of the stream, -1 on failure.
+int memio_open_input(const char *data, size_t length);
+
+/// Opens a stream writing into a buffer, which must outlive the stream.
+/// Writes past its capacity are dropped, but still counted.
+/// @param data Buffer to write into.
+/// @param capacity Number of bytes of the buffer.
+/// @return Descriptor of the stream, -1 on failure.
+int memio_open_output(char *data, size_t capacity);
+
+/// Returns the number of bytes written to a stream, including the ones that
+/// did not fit in its buffer.
+size_t memio_length(int fd);
+
+/// Like read(), for a file or a stream.
+ssize_t io_read(int fd, void *buf, size_t count);
+
+/// Like write(), for a file or a stream. Writes to a stream are atomic.
+ssize_t io_write(int fd, const void *buf, size_t count);
+
+/// Like lseek(), for a file or a stream.
+off_t io_seek(int fd, off_t offset, int whence);
+
+/// Like close(), for a file or a stream.
+int io_close(int fd);
+
+#endif // EMS_MEMIO_H
@@ -0,0 +1,42 @@
+#include "memory.h"
+#include <stdatomic.h>
+
+static size_t budget = 0;
+static atomic_size_t current = 0;
+static atomic_size_t peak = 0;
+
+void memory_configure(size_t budget_bytes) { budget = budget_bytes; }
+
+// Account the bytes only if they fit in the budget
+int memory_charge(size_t bytes) {
+    size_t used = atomic_load_explicit(&current, memory_order_relaxed);
+    size_t next;
+    do {
+        if (__builtin_add_overflow(used, bytes, &next) ||
+            (budget != 0 && next > budget)) {
+            return 1;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(
+        &current, &used, next, memory_order_relaxed, memory_order_relaxed));
+
+    // Raise the peak, unless another thread raised it higher
+    size_t highest = atomic_load_explicit(&peak, memory_order_relaxed);
+    while (highest < next &&
+           !atomic_compare_exchange_weak_explicit(&peak, &highest, next,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+    return 0;
+}
+
+void memory_release(size_t bytes) {
+    atomic_fetch_sub_explicit(&current, bytes, memory_order_relaxed);
+}
+
+size_t memory_current() {
+    return atomic_load_explicit(&current, memory_order_relaxed);
+}
+
+size_t memory_peak() {
+    return atomic_load_explicit(&peak, memory_order_relaxed);
+}
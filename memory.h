@@ -0,0 +1,26 @@
+#ifndef EMS_MEMORY_H
+#define EMS_MEMORY_H
+
+#include <stddef.h>
+
+/// Sets the number of bytes events may use in each process, 0 for no limit.
+/// Event tables, tile arrays, seat tiles (with their seat locks), row
+/// indexes, contention counters, reservation copies and cached SHOW renders
+/// are accounted against it.
+void memory_configure(size_t budget_bytes);
+
+/// Accounts bytes about to be allocated for events.
+/// @param bytes Number of bytes.
+/// @return 0 if they fit in the budget and were accounted, 1 otherwise.
+int memory_charge(size_t bytes);
+
+/// Accounts bytes of events that were freed.
+void memory_release(size_t bytes);
+
+/// Returns the number of bytes currently used by events.
+size_t memory_current();
+
+/// Returns the highest number of bytes used by events at any time.
+size_t memory_peak();
+
+#endif // EMS_MEMORY_H
@@ -1,7 +1,16 @@
 #define _GNU_SOURCE
+#include "operations.h"
+#include "affinity.h"
 #include "eventlist.h"
+#include "memio.h"
+#include "memory.h"
+#include "trace.h"
+#include "vclock.h"
+#include "varint.h"
+#include "wal.h"
 #include <limits.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,6 +28,22 @@ static struct EventList *event_list = NULL;
 
 static unsigned int state_access_delay_ms = 0;
 
+static enum ShowFormat show_format = SHOW_TEXT;
+
+/// Incremented whenever the event list is reset, which makes every handle
+/// resolved before stale.
+static atomic_uint event_list_generation = 0;
+
+/// Handles of the events the thread used recently, by event id modulo
+/// EVENT_CACHE_SIZE. Events are only freed when the list is reset, so a
+/// handle of the current generation is always safe to use.
+static _Thread_local struct EventHandle event_cache[EVENT_CACHE_SIZE];
+
+/// Rendered LIST output, valid until an event is created.
+static struct Output list_output = {NULL, 0, 0};
+static int list_output_valid = 0;
+static pthread_mutex_t list_output_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /// Calculates a timespec from a delay in milliseconds.
 /// @param delay_ms Delay in milliseconds.
 /// @return Timespec with the given delay.
@@ -26,39 +51,984 @@ static struct timespec delay_to_timespec(unsigned int delay_ms) {
     return (struct timespec){delay_ms / 1000, (delay_ms % 1000) * 1000000};
 }
 
+/// Waits the state access delay, to simulate a real system accessing a costly
+/// memory resource. A zero delay skips the sleep, which would still cost a
+/// timer wake up. With the virtual clock, only simulated time passes.
+static void simulate_state_access() {
+    if (state_access_delay_ms == 0) {
+        return;
+    }
+    if (vclock_enabled()) {
+        vclock_advance(state_access_delay_ms);
+        return;
+    }
+
+    struct timespec delay = delay_to_timespec(state_access_delay_ms);
+    nanosleep(&delay, NULL); // Should not be removed
+}
+
 /// Gets the event with the given ID from the state.
 /// @note Will wait to simulate a real system accessing a costly memory
 /// resource.
 // @param event_id The ID of the event to get.
 /// @return Pointer to the event if found, NULL otherwise.
 static struct Event *get_event_with_delay(unsigned int event_id) {
-    struct timespec delay = delay_to_timespec(state_access_delay_ms);
-    nanosleep(&delay, NULL); // Should not be removed
+    simulate_state_access();
 
     return get_event(event_list, event_id);
 }
 
-/// Gets the seat with the given index from the state.
+/// Resolves an event, from the calling thread's handle cache if possible.
+/// @note Will wait to simulate a real system accessing a costly memory
+/// resource, unless the event is cached.
+/// @param event_id The ID of the event to get.
+/// @return Pointer to the event if found, NULL otherwise.
+static struct Event *open_event(unsigned int event_id) {
+    struct EventHandle handle;
+    return ems_open_event(event_id, &handle) == 0 ? handle.event : NULL;
+}
+
+/// Gets the index of the tile holding a seat.
+/// @note This function assumes that the seat exists.
+/// @param event Event to get the tile index from.
+/// @param row Row of the seat.
+/// @param col Column of the seat.
+/// @return Index of the tile.
+static size_t tile_index(struct Event *event, size_t row, size_t col) {
+    return (row - 1) / TILE_ROWS * event->tile_cols + (col - 1) / TILE_COLS;
+}
+
+/// Gets the index of a seat inside its tile.
+/// @param row Row of the seat.
+/// @param col Column of the seat.
+/// @return Index of the seat in the tile's arrays.
+static size_t seat_index(size_t row, size_t col) {
+    return (row - 1) % TILE_ROWS * TILE_COLS + (col - 1) % TILE_COLS;
+}
+
+/// Gets the tile holding a seat.
+/// @param event Event to get the tile from.
+/// @param row Row of the seat.
+/// @param col Column of the seat.
+/// @return Pointer to the tile, NULL if it was never allocated.
+static struct SeatTile *get_tile(struct Event *event, size_t row,
+                                 size_t col) {
+    return atomic_load_explicit(&event->tiles[tile_index(event, row, col)],
+                                memory_order_acquire);
+}
+
+/// Gets the tile holding a seat, allocating it if needed.
+/// @param event Event to get the tile from.
+/// @param row Row of the seat.
+/// @param col Column of the seat.
+/// @return Pointer to the tile, NULL if it could not be allocated.
+static struct SeatTile *get_or_create_tile(struct Event *event, size_t row,
+                                           size_t col) {
+    struct SeatTile *tile = get_tile(event, row, col);
+    if (tile != NULL) {
+        return tile;
+    }
+
+    pthread_mutex_lock(&event->tile_lock);
+
+    // Another thread may have allocated it in the meantime
+    tile = get_tile(event, row, col);
+    if (tile == NULL && memory_charge(sizeof(struct SeatTile)) == 0) {
+        tile = calloc(1, sizeof(struct SeatTile));
+        if (tile == NULL) {
+            memory_release(sizeof(struct SeatTile));
+        } else {
+            event->memory += sizeof(struct SeatTile);
+            for (size_t i = 0; i < TILE_ROWS * TILE_COLS; i++) {
+                pthread_mutex_init(&tile->mutexes[i], NULL);
+            }
+            atomic_store_explicit(&event->tiles[tile_index(event, row, col)],
+                                  tile, memory_order_release);
+        }
+    }
+
+    pthread_mutex_unlock(&event->tile_lock);
+    return tile;
+}
+
+/// Gets the seat with the given coordinates from the state.
 /// @note Will wait to simulate a real system accessing a costly memory
 /// resource.
 /// @param event Event to get the seat from.
-/// @param index Index of the seat to get.
-// @return Pointer to the seat.
-static unsigned int *get_seat_with_delay(struct Event *event, size_t index) {
-    struct timespec delay = delay_to_timespec(state_access_delay_ms);
-    nanosleep(&delay, NULL); // Should not be removed
+/// @param row Row of the seat.
+/// @param col Column of the seat.
+// @return Pointer to the seat, NULL if its tile was never allocated (the seat
+// is free).
+static unsigned int *get_seat_with_delay(struct Event *event, size_t row,
+                                         size_t col) {
+    simulate_state_access();
+
+    struct SeatTile *tile = get_tile(event, row, col);
+    return tile != NULL ? &tile->data[seat_index(row, col)] : NULL;
+}
 
-    return &event->data[index];
+/// Tiles covering a rectangle of seats, as they were when its seats were
+/// locked.
+struct BlockTiles {
+    size_t first_row;        // First row of the first tile row.
+    size_t first_col;        // First column of the first tile column.
+    size_t rows;             // Number of tile rows.
+    size_t cols;             // Number of tile columns.
+    struct SeatTile **tiles; // Tiles in row major order, NULL where missing.
+};
+
+/// Gets the tile of a snapshot holding a seat.
+/// @param snapshot Tiles of a rectangle holding the seat.
+/// @param row Row of the seat.
+/// @param col Column of the seat.
+/// @return Pointer to the tile, NULL if it was missing.
+static struct SeatTile *snapshot_tile(const struct BlockTiles *snapshot,
+                                      size_t row, size_t col) {
+    return snapshot->tiles[(row - snapshot->first_row) / TILE_ROWS *
+                               snapshot->cols +
+                           (col - snapshot->first_col) / TILE_COLS];
 }
 
-/// Gets the index of a seat.
-/// @note This function assumes that the seat exists.
-/// @param event Event to get the seat index from.
+/// Gets the reservation of a seat from the state.
+/// @note Will wait to simulate a real system accessing a costly memory
+/// resource.
+/// @param event Event to get the seat from.
+/// @param snapshot Tiles to read the seat from, NULL for the event's tiles.
 /// @param row Row of the seat.
 /// @param col Column of the seat.
-/// @return Index of the seat.
-static size_t seat_index(struct Event *event, size_t row, size_t col) {
-    return (row - 1) * event->cols + col - 1;
+/// @return Id of the reservation, 0 if the seat is free.
+static unsigned int read_seat_with_delay(struct Event *event,
+                                         const struct BlockTiles *snapshot,
+                                         size_t row, size_t col) {
+    if (snapshot == NULL) {
+        unsigned int *seat = get_seat_with_delay(event, row, col);
+        return seat != NULL ? *seat : 0;
+    }
+
+    simulate_state_access();
+    struct SeatTile *tile = snapshot_tile(snapshot, row, col);
+    return tile != NULL ? tile->data[seat_index(row, col)] : 0;
+}
+
+/// Marks a row as changed since the event was last shown.
+/// @param event Event the row belongs to.
+/// @param row Row to mark.
+static void mark_row_dirty(struct Event *event, size_t row) {
+    atomic_fetch_or_explicit(&event->dirty_rows[(row - 1) / 64],
+                             (uint_least64_t)1 << ((row - 1) % 64),
+                             memory_order_relaxed);
+}
+
+/// Marks a row as having had seats reserved.
+/// @param event Event the row belongs to.
+/// @param row Row to mark.
+static void mark_row_reserved(struct Event *event, size_t row) {
+    atomic_fetch_or_explicit(&event->reserved_rows[(row - 1) / 64],
+                             (uint_least64_t)1 << ((row - 1) % 64),
+                             memory_order_relaxed);
+}
+
+/// Checks whether seats of a row were ever reserved.
+/// @param event Event the row belongs to.
+/// @param row Row to check.
+/// @return 1 if the row was reserved, 0 if it has always been all free.
+static int row_was_reserved(struct Event *event, size_t row) {
+    uint_least64_t word = atomic_load_explicit(
+        &event->reserved_rows[(row - 1) / 64], memory_order_relaxed);
+    return (int)((word >> ((row - 1) % 64)) & 1);
+}
+
+/// Appends bytes to a rendered output buffer.
+/// @param output Output to append to.
+/// @param str Bytes to append.
+/// @param len Number of bytes to append.
+/// @return 0 if the bytes were appended successfully, 1 otherwise.
+static int append_output(struct Output *output, const char *str, size_t len) {
+    if (output->len + len > output->cap) {
+        size_t new_cap = output->cap ? output->cap * 2 : 256;
+        while (new_cap < output->len + len) {
+            new_cap *= 2;
+        }
+
+        char *new_data = realloc(output->data, new_cap);
+        if (new_data == NULL) {
+            return 1;
+        }
+        output->data = new_data;
+        output->cap = new_cap;
+    }
+
+    memcpy(output->data + output->len, str, len);
+    output->len += len;
+    return 0;
+}
+
+/// Renders some columns of a row of an event, one reservation id per seat.
+/// @note The caller must hold the event's lock for writing, or the locks of
+/// the seats.
+/// @param event Event to render the row from.
+/// @param span Seats to render.
+/// @param snapshot Tiles to read the seats from, NULL for the event's tiles.
+/// @param output Output to append the row to.
+/// @return 0 if the row was rendered successfully, 1 otherwise.
+static int render_span(struct Event *event, const struct SeatSpan *span,
+                       const struct BlockTiles *snapshot,
+                       struct Output *output) {
+    for (size_t j = span->col_from; j <= span->col_to; j++) {
+        unsigned int id = read_seat_with_delay(event, snapshot, span->row, j);
+
+        char seat_str[64];
+        int length = snprintf(seat_str, 64, "%u ", id);
+
+        if (append_output(output, seat_str, (size_t)length) != 0) {
+            return 1;
+        }
+    }
+
+    // Add a newline after each row
+    return append_output(output, "\n", 1);
+}
+
+/// Renders a row of an event, one reservation id per seat.
+/// @note The caller must hold the event's lock for writing.
+static int render_row(struct Event *event, size_t row, struct Output *output) {
+    struct SeatSpan span = {row, 1, event->cols};
+    return render_span(event, &span, NULL, output);
+}
+
+/// Appends a run of seats to a binary SHOW record.
+/// @param output Output to append to.
+/// @param reservation_id Reservation of the seats, 0 if they are free.
+/// @param length Number of seats.
+/// @return 0 if the run was appended successfully, 1 otherwise.
+static int append_run(struct Output *output, unsigned int reservation_id,
+                      size_t length) {
+    unsigned char buffer[2 * VARINT_MAX_BYTES];
+    unsigned char *end = put_varint(buffer, reservation_id);
+    end = put_varint(end, length);
+    return append_output(output, (const char *)buffer,
+                         (size_t)(end - buffer));
+}
+
+/// Renders a rectangle of seats of an event in the SHOW format, as if it
+/// were a whole event of its size.
+/// @note The caller must hold the event's lock for writing, or the locks of
+/// the seats.
+/// @param event Event to render.
+/// @param block Seats to render.
+/// @param snapshot Tiles to read the seats from, NULL for the event's tiles.
+/// @param output Output to append the seats to.
+/// @return 0 if the seats were rendered successfully, 1 otherwise.
+static int render_block(struct Event *event, const struct SeatBlock *block,
+                        const struct BlockTiles *snapshot,
+                        struct Output *output) {
+    if (show_format == SHOW_TEXT) {
+        for (size_t i = block->row_from; i <= block->row_to; i++) {
+            struct SeatSpan span = {i, block->col_from, block->col_to};
+            if (render_span(event, &span, snapshot, output) != 0) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    unsigned char header[2 + 3 * VARINT_MAX_BYTES] = {SHOW_RECORD_MARKER,
+                                                      SHOW_RECORD_TYPE};
+    unsigned char *end = put_varint(header + 2, event->id);
+    end = put_varint(end, block->row_to - block->row_from + 1);
+    end = put_varint(end, block->col_to - block->col_from + 1);
+    if (append_output(output, (const char *)header,
+                      (size_t)(end - header)) != 0) {
+        return 1;
+    }
+
+    // Runs of seats of the same reservation may continue on the next row
+    unsigned int run_id = 0;
+    size_t run_length = 0;
+    for (size_t i = block->row_from; i <= block->row_to; i++) {
+        for (size_t j = block->col_from; j <= block->col_to; j++) {
+            unsigned int id = read_seat_with_delay(event, snapshot, i, j);
+
+            if (run_length > 0 && id != run_id) {
+                if (append_run(output, run_id, run_length) != 0) {
+                    return 1;
+                }
+                run_length = 0;
+            }
+            run_id = id;
+            run_length++;
+        }
+    }
+
+    return run_length > 0 ? append_run(output, run_id, run_length) : 0;
+}
+
+/// Renders a whole event in the SHOW format.
+/// @note The caller must hold the event's lock for writing.
+static int render_event(struct Event *event, struct Output *output) {
+    struct SeatBlock block = {1, 1, event->rows, event->cols};
+    return render_block(event, &block, NULL, output);
+}
+
+/// Orders spans by row and then by first column, which is the order their
+/// seats are locked in.
+static int compare_spans(const void *a, const void *b) {
+    const struct SeatSpan *span_a = a, *span_b = b;
+    if (span_a->row != span_b->row) {
+        return span_a->row < span_b->row ? -1 : 1;
+    }
+    return (span_a->col_from > span_b->col_from) -
+           (span_a->col_from < span_b->col_from);
+}
+
+/// Allocates the tiles covering a span of seats.
+/// @param event Event the span belongs to.
+/// @param span Span of seats.
+/// @return 0 if the tiles were allocated, 1 otherwise, including when they
+/// do not fit in the memory budget.
+static int create_span_tiles(struct Event *event,
+                             const struct SeatSpan *span) {
+    // Visit the first column of each tile the span crosses
+    for (size_t col = span->col_from; col <= span->col_to;
+         col = (col - 1) / TILE_COLS * TILE_COLS + TILE_COLS + 1) {
+        if (get_or_create_tile(event, span->row, col) == NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/// Locks the mutex of every seat in a span, from left to right. With
+/// contention counters, a lock found taken is counted before waiting for it.
+/// @note The span's tiles must have been allocated.
+static void lock_span(struct Event *event, const struct SeatSpan *span) {
+    uint64_t wait_start = trace_now();
+    for (size_t col = span->col_from; col <= span->col_to; col++) {
+        struct SeatTile *tile = get_tile(event, span->row, col);
+        pthread_mutex_t *mutex = &tile->mutexes[seat_index(span->row, col)];
+        if (event->contention == NULL || pthread_mutex_trylock(mutex) != 0) {
+            if (event->contention != NULL) {
+                contention_record_wait(event->contention, span->row, col);
+            }
+            pthread_mutex_lock(mutex);
+        }
+    }
+    trace_wait("seat locks", wait_start);
+}
+
+/// Unlocks the mutex of every seat in a span.
+static void unlock_span(struct Event *event, const struct SeatSpan *span) {
+    for (size_t col = span->col_from; col <= span->col_to; col++) {
+        struct SeatTile *tile = get_tile(event, span->row, col);
+        pthread_mutex_unlock(&tile->mutexes[seat_index(span->row, col)]);
+    }
+}
+
+/// Reads the tiles of a snapshot's rectangle, or checks them against it.
+/// @param event Event the snapshot's rectangle belongs to.
+/// @param snapshot Snapshot of the rectangle.
+/// @param update Whether to record the tiles in the snapshot.
+/// @return 1 if a tile was allocated since the snapshot was taken, 0
+/// otherwise.
+static int refresh_block_tiles(struct Event *event,
+                               struct BlockTiles *snapshot, int update) {
+    int changed = 0;
+    for (size_t i = 0; i < snapshot->rows; i++) {
+        for (size_t j = 0; j < snapshot->cols; j++) {
+            struct SeatTile *tile =
+                get_tile(event, snapshot->first_row + i * TILE_ROWS,
+                         snapshot->first_col + j * TILE_COLS);
+            changed |= tile != snapshot->tiles[i * snapshot->cols + j];
+            if (update) {
+                snapshot->tiles[i * snapshot->cols + j] = tile;
+            }
+        }
+    }
+    return changed;
+}
+
+/// Records the tiles covering a rectangle of seats that are allocated,
+/// without allocating the others.
+/// @param event Event the rectangle belongs to.
+/// @param block Rectangle of seats.
+/// @param snapshot Set to the tiles of the rectangle, to be freed by the
+/// caller.
+/// @return 0 if the snapshot was taken, 1 if it could not be allocated.
+static int snapshot_block_tiles(struct Event *event,
+                                const struct SeatBlock *block,
+                                struct BlockTiles *snapshot) {
+    snapshot->first_row = (block->row_from - 1) / TILE_ROWS * TILE_ROWS + 1;
+    snapshot->first_col = (block->col_from - 1) / TILE_COLS * TILE_COLS + 1;
+    snapshot->rows = (block->row_to - snapshot->first_row) / TILE_ROWS + 1;
+    snapshot->cols = (block->col_to - snapshot->first_col) / TILE_COLS + 1;
+    snapshot->tiles =
+        calloc(snapshot->rows * snapshot->cols, sizeof(struct SeatTile *));
+    if (snapshot->tiles == NULL) {
+        return 1;
+    }
+
+    refresh_block_tiles(event, snapshot, 1);
+    return 0;
+}
+
+/// Locks or unlocks the seats of a rectangle that are in the tiles of a
+/// snapshot, row by row and from left to right, the order reservations lock
+/// theirs in.
+/// @param event Event the rectangle belongs to.
+/// @param block Rectangle of seats.
+/// @param snapshot Tiles of the rectangle.
+/// @param lock 1 to lock the seats, 0 to unlock them.
+static void lock_block_seats(struct Event *event, const struct SeatBlock *block,
+                             const struct BlockTiles *snapshot, int lock) {
+    for (size_t row = block->row_from; row <= block->row_to; row++) {
+        for (size_t col = block->col_from; col <= block->col_to;) {
+            size_t last = (col - 1) / TILE_COLS * TILE_COLS + TILE_COLS;
+            struct SeatSpan span = {
+                row, col, last < block->col_to ? last : block->col_to};
+            if (snapshot_tile(snapshot, row, col) != NULL) {
+                if (lock) {
+                    lock_span(event, &span);
+                } else {
+                    unlock_span(event, &span);
+                }
+            }
+            col = span.col_to + 1;
+        }
+    }
+}
+
+/// Checks whether every seat in a span is free.
+/// @note Will wait once per span to simulate a real system accessing a
+/// costly memory resource; the seats of a row are stored together.
+/// @param event Event the span belongs to.
+/// @param span Span of seats, whose tiles must have been allocated.
+/// @return 1 if all the seats are free, 0 otherwise.
+static int span_is_free_with_delay(struct Event *event,
+                                   const struct SeatSpan *span) {
+    simulate_state_access();
+
+    for (size_t col = span->col_from; col <= span->col_to; col++) {
+        if (get_tile(event, span->row, col)
+                ->data[seat_index(span->row, col)] != 0) {
+            if (event->contention != NULL) {
+                contention_record_conflict(event->contention, span->row, col);
+            }
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/// Gets the bits of a tile's row bitmap covering some of its columns.
+/// @param col_from First column, in the same tile as col_to.
+/// @param col_to Last column.
+/// @return Bitmap with the bits of the columns set.
+static uint_least64_t span_mask(size_t col_from, size_t col_to) {
+    size_t width = col_to - col_from + 1;
+    uint_least64_t bits = width == 64 ? ~(uint_least64_t)0
+                                      : ((uint_least64_t)1 << width) - 1;
+    return bits << ((col_from - 1) % TILE_COLS);
+}
+
+/// Gets the free run index of a row, building it from the bitmaps of the
+/// row's tiles the first time RESERVE_BEST scans the row.
+/// @note The caller must hold the event's lock for writing.
+/// @param event Event to get the index from.
+/// @param row Row of the index.
+/// @return Pointer to the index, NULL if it could not be allocated.
+static struct RowIndex *get_or_create_row_index(struct Event *event,
+                                                size_t row) {
+    struct RowIndex *index = atomic_load_explicit(&event->row_index[row - 1],
+                                                  memory_order_relaxed);
+    if (index != NULL) {
+        return index;
+    }
+
+    size_t size = row_index_size(event->cols);
+    if (memory_charge(size) != 0) {
+        return NULL;
+    }
+    index = row_index_create(event->cols);
+    if (index == NULL) {
+        memory_release(size);
+        return NULL;
+    }
+
+    // Mark each run of taken seats of the tiles the row crosses
+    for (size_t col = 1; col <= event->cols; col += TILE_COLS) {
+        struct SeatTile *tile = get_tile(event, row, col);
+        uint_least64_t booked =
+            tile != NULL ? atomic_load_explicit(
+                               &tile->booked[(row - 1) % TILE_ROWS],
+                               memory_order_relaxed)
+                         : 0;
+        while (booked != 0) {
+            size_t first = (size_t)__builtin_ctzll(booked);
+            uint_least64_t rest = ~(booked >> first);
+            size_t width =
+                rest != 0 ? (size_t)__builtin_ctzll(rest) : TILE_COLS - first;
+            row_index_set(index, col + first, col + first + width - 1, 0);
+            booked &= ~span_mask(col + first, col + first + width - 1);
+        }
+    }
+
+    pthread_mutex_lock(&event->tile_lock);
+    event->memory += size;
+    pthread_mutex_unlock(&event->tile_lock);
+    atomic_store_explicit(&event->row_index[row - 1], index,
+                          memory_order_release);
+    return index;
+}
+
+/// Assigns every seat in a span to a reservation, or frees them, and updates
+/// the indexes of its row.
+/// @param event Event the span belongs to.
+/// @param span Span of seats, whose tiles and row index must be allocated.
+/// @param reservation_id Reservation to assign the seats to, 0 to free them.
+static void fill_span(struct Event *event, const struct SeatSpan *span,
+                      unsigned int reservation_id) {
+    for (size_t col = span->col_from; col <= span->col_to; col++) {
+        get_tile(event, span->row, col)->data[seat_index(span->row, col)] =
+            reservation_id;
+    }
+
+    // Update the span's bits in the occupancy bitmap of each tile it crosses
+    for (size_t col = span->col_from; col <= span->col_to;) {
+        size_t last = (col - 1) / TILE_COLS * TILE_COLS + TILE_COLS;
+        if (last > span->col_to) {
+            last = span->col_to;
+        }
+
+        struct SeatTile *tile = get_tile(event, span->row, col);
+        atomic_uint_least64_t *word =
+            &tile->booked[(span->row - 1) % TILE_ROWS];
+        if (reservation_id != 0) {
+            atomic_fetch_or_explicit(word, span_mask(col, last),
+                                     memory_order_relaxed);
+        } else {
+            atomic_fetch_and_explicit(word, ~span_mask(col, last),
+                                      memory_order_relaxed);
+        }
+        col = last + 1;
+    }
+
+    size_t width = span->col_to - span->col_from + 1;
+    if (reservation_id != 0) {
+        atomic_fetch_add_explicit(&event->booked_seats, width,
+                                  memory_order_relaxed);
+    } else {
+        atomic_fetch_sub_explicit(&event->booked_seats, width,
+                                  memory_order_relaxed);
+    }
+
+    // Once RESERVE_BEST has built the index of the row it is kept up to date;
+    // other reservations in the row may be filling disjoint spans
+    struct RowIndex *index = atomic_load_explicit(
+        &event->row_index[span->row - 1], memory_order_acquire);
+    if (index != NULL) {
+        pthread_mutex_lock(&index->lock);
+        row_index_set(index, span->col_from, span->col_to,
+                      reservation_id == 0);
+        pthread_mutex_unlock(&index->lock);
+    }
+
+    if (reservation_id != 0) {
+        mark_row_reserved(event, span->row);
+    }
+    mark_row_dirty(event, span->row);
+    atomic_fetch_add_explicit(&event->version, 1, memory_order_relaxed);
+}
+
+/// Makes room for a reservation id in the index of the reservations of an
+/// event.
+/// @note The caller must hold reservation_id_lock.
+/// @param event Event the reservation belongs to.
+/// @param reservation_id Id of the reservation.
+/// @return 0 if the index has room for the id, 1 if it could not be grown.
+static int grow_reservation_index(struct Event *event,
+                                  unsigned int reservation_id) {
+    if (reservation_id < event->reservation_seats_cap) {
+        return 0;
+    }
+
+    size_t new_cap =
+        event->reservation_seats_cap ? event->reservation_seats_cap * 2 : 16;
+    while (new_cap <= reservation_id) {
+        new_cap *= 2;
+    }
+
+    size_t added =
+        (new_cap - event->reservation_seats_cap) * sizeof(struct Reservation *);
+    if (memory_charge(added) != 0) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        return 1;
+    }
+    struct Reservation **grown = realloc(
+        event->reservation_seats, new_cap * sizeof(struct Reservation *));
+    if (grown == NULL) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        memory_release(added);
+        return 1;
+    }
+
+    for (size_t i = event->reservation_seats_cap; i < new_cap; i++) {
+        grown[i] = NULL;
+    }
+    event->reservation_seats = grown;
+    event->reservation_seats_cap = new_cap;
+    return 0;
+}
+
+/// Copies the spans of a reservation, accounting the copy against the memory
+/// budget until it is freed.
+/// @return Newly allocated copy, NULL on failure.
+static struct Reservation *copy_reservation(size_t num_spans,
+                                            const struct SeatSpan *spans) {
+    size_t size = reservation_size(num_spans);
+    if (memory_charge(size) != 0) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        return NULL;
+    }
+    struct Reservation *reservation = malloc(size);
+    if (reservation == NULL) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        memory_release(size);
+        return NULL;
+    }
+
+    reservation->num_spans = num_spans;
+    memcpy(reservation->spans, spans, num_spans * sizeof(struct SeatSpan));
+    return reservation;
+}
+
+/// Frees the copy of a reservation and releases it from the memory budget.
+/// @param reservation Copy made by copy_reservation(), may be NULL.
+static void free_reservation(struct Reservation *reservation) {
+    if (reservation != NULL) {
+        memory_release(reservation_size(reservation->num_spans));
+        free(reservation);
+    }
+}
+
+/// Seats of one event taking part in a reservation.
+struct EventSpans {
+    struct Event *event;
+    size_t num_spans;
+    struct SeatSpan *spans; // Sorted by compare_spans(), inside the event.
+};
+
+/// Takes the next reservation id of each event and records the spans of its
+/// reservation under it, so it can be cancelled. Either every event gets an
+/// id or none does, and the seats are only filled afterwards, so a failed
+/// allocation leaves no reservation booked.
+/// @param num_groups Number of events, all different.
+/// @param groups Seats of each event.
+/// @param reservation_ids Set to the id of each event's reservation.
+/// @return 0 if every reservation got its id, 1 otherwise.
+static int new_reservations(size_t num_groups, const struct EventSpans *groups,
+                            unsigned int *reservation_ids) {
+    pthread_mutex_lock(&reservation_id_lock);
+
+    // The lock keeps every id from being taken until all copies are stored
+    size_t stored = 0;
+    for (; stored < num_groups; stored++) {
+        struct Event *event = groups[stored].event;
+        unsigned int reservation_id =
+            atomic_load_explicit(&event->reservations, memory_order_relaxed) +
+            1;
+        if (grow_reservation_index(event, reservation_id) != 0) {
+            break;
+        }
+
+        struct Reservation *reservation =
+            copy_reservation(groups[stored].num_spans, groups[stored].spans);
+        if (reservation == NULL) {
+            break;
+        }
+        event->reservation_seats[reservation_id] = reservation;
+        reservation_ids[stored] = reservation_id;
+    }
+
+    int result = stored < num_groups;
+    for (size_t g = 0; g < stored; g++) {
+        struct Event *event = groups[g].event;
+        if (result != 0) {
+            free_reservation(event->reservation_seats[reservation_ids[g]]);
+            event->reservation_seats[reservation_ids[g]] = NULL;
+        } else {
+            atomic_store_explicit(&event->reservations, reservation_ids[g],
+                                  memory_order_relaxed);
+        }
+    }
+
+    pthread_mutex_unlock(&reservation_id_lock);
+    return result;
+}
+
+/// Assigns every seat in a span to a reservation, or frees them.
+/// @note Will wait once per span to simulate a real system accessing a
+/// costly memory resource.
+/// @param event Event the span belongs to.
+/// @param span Span of seats, whose tiles must have been allocated.
+/// @param reservation_id Reservation to assign the seats to, 0 to free them.
+static void fill_span_with_delay(struct Event *event,
+                                 const struct SeatSpan *span,
+                                 unsigned int reservation_id) {
+    simulate_state_access();
+
+    fill_span(event, span, reservation_id);
+}
+
+/// Orders the seats of a reservation by event id.
+static int compare_groups(const void *a, const void *b) {
+    unsigned int id_a = ((const struct EventSpans *)a)->event->id;
+    unsigned int id_b = ((const struct EventSpans *)b)->event->id;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+/// Logs the reservations made for the seats of one or more events, as a single
+/// record so they are also recovered all at once.
+static void log_groups(size_t num_groups, const struct EventSpans *groups,
+                       const unsigned int *reservation_ids) {
+    if (num_groups == 1) {
+        wal_log_reserve(groups[0].event->id, reservation_ids[0],
+                        groups[0].num_spans, groups[0].spans);
+        return;
+    }
+
+    if (!wal_enabled()) {
+        return;
+    }
+
+    unsigned int *event_ids = malloc(num_groups * sizeof(unsigned int));
+    size_t *num_spans = malloc(num_groups * sizeof(size_t));
+    const struct SeatSpan **spans =
+        malloc(num_groups * sizeof(struct SeatSpan *));
+
+    if (event_ids == NULL || num_spans == NULL || spans == NULL) {
+        fprintf(stderr, "Error allocating memory for log record\n");
+    } else {
+        for (size_t g = 0; g < num_groups; g++) {
+            event_ids[g] = groups[g].event->id;
+            num_spans[g] = groups[g].num_spans;
+            spans[g] = groups[g].spans;
+        }
+        wal_log_reserve_multi(num_groups, event_ids, reservation_ids,
+                              num_spans, spans);
+    }
+
+    free(event_ids);
+    free(num_spans);
+    free(spans);
+}
+
+/// Keeps an event from being read as a whole while seats are changing.
+static void lock_event_for_reserve(struct Event *event) {
+    uint64_t wait_start = trace_now();
+    pthread_rwlock_rdlock(&event->lock);
+    trace_wait("event lock", wait_start);
+}
+
+/// Allocates the tiles of the seats of an event on first use, before taking
+/// any seat lock.
+/// @note The caller must hold the event's lock for reading.
+/// @return 0 if the tiles were allocated successfully, 1 otherwise.
+static int create_group_tiles(const struct EventSpans *group) {
+    for (size_t i = 0; i < group->num_spans; i++) {
+        if (create_span_tiles(group->event, &group->spans[i]) != 0) {
+            fprintf(stderr, "Error allocating memory for event data\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/// Reserves the seats of one or more events all at once, once their events
+/// are locked and their tiles allocated.
+/// @note The caller must hold the lock of every event for reading.
+/// @param num_groups Number of events.
+/// @param groups Seats of each event, sorted by event id.
+/// @return 0 if the seats were reserved successfully, 1 otherwise.
+static int reserve_locked_groups(size_t num_groups,
+                                 const struct EventSpans *groups) {
+    int result = 0;
+
+    // Lock seat mutexes
+    for (size_t g = 0; g < num_groups; g++) {
+        for (size_t i = 0; i < groups[g].num_spans; i++) {
+            lock_span(groups[g].event, &groups[g].spans[i]);
+        }
+    }
+
+    // Nothing is written until every seat is known to be free, so a
+    // conflict leaves no partial state to roll back
+    for (size_t g = 0; g < num_groups && result == 0; g++) {
+        for (size_t i = 0; i < groups[g].num_spans; i++) {
+            if (!span_is_free_with_delay(groups[g].event,
+                                         &groups[g].spans[i])) {
+                fprintf(stderr, "Seat already reserved\n");
+                result = 1;
+                break;
+            }
+        }
+    }
+
+    // A single event, the common case, needs no allocation
+    unsigned int single_id;
+    unsigned int *reservation_ids =
+        num_groups == 1 ? &single_id
+                        : malloc(num_groups * sizeof(unsigned int));
+    if (result == 0 && reservation_ids == NULL) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        result = 1;
+    }
+
+    // Only successful reservations take an id
+    if (result == 0) {
+        result = new_reservations(num_groups, groups, reservation_ids);
+    }
+
+    for (size_t g = 0; g < num_groups && result == 0; g++) {
+        const struct EventSpans *group = &groups[g];
+        for (size_t i = 0; i < group->num_spans; i++) {
+            fill_span_with_delay(group->event, &group->spans[i],
+                                 reservation_ids[g]);
+        }
+    }
+
+    // Log the reservations while their seats are still locked
+    if (result == 0) {
+        log_groups(num_groups, groups, reservation_ids);
+    }
+
+    if (reservation_ids != &single_id) {
+        free(reservation_ids);
+    }
+
+    // Unlock seat mutexes
+    for (size_t g = num_groups; g > 0; g--) {
+        for (size_t i = 0; i < groups[g - 1].num_spans; i++) {
+            unlock_span(groups[g - 1].event, &groups[g - 1].spans[i]);
+        }
+    }
+
+    return result;
+}
+
+/// Reserves the seats of one or more events all at once: either every event
+/// gets a reservation or none of them does. Events are locked in the order
+/// given and the seats of each event in (row, column) order, so groups
+/// sorted by event id never deadlock with each other.
+/// @param num_groups Number of events.
+/// @param groups Seats of each event, sorted by event id.
+/// @return 0 if the seats were reserved successfully, 1 otherwise.
+static int reserve_groups(size_t num_groups, const struct EventSpans *groups) {
+    size_t locked = 0;
+    int result = 0;
+    for (; locked < num_groups && result == 0; locked++) {
+        lock_event_for_reserve(groups[locked].event);
+        result = create_group_tiles(&groups[locked]);
+    }
+
+    if (result == 0) {
+        result = reserve_locked_groups(num_groups, groups);
+    }
+
+    for (size_t g = locked; g > 0; g--) {
+        pthread_rwlock_unlock(&groups[g - 1].event->lock);
+    }
+    return result;
+}
+
+/// Checks the seats and blocks of a reservation and turns them into sorted,
+/// non overlapping spans.
+/// @param event Event the seats belong to.
+/// @param num_seats Number of single seats.
+/// @param xs Array of rows of the single seats.
+/// @param ys Array of columns of the single seats.
+/// @param num_blocks Number of blocks.
+/// @param blocks Array of blocks.
+/// @param num_spans Set to the number of spans.
+/// @return Array of spans to be freed by the caller, NULL on failure.
+static struct SeatSpan *build_spans(struct Event *event, size_t num_seats,
+                                    const size_t *xs, const size_t *ys,
+                                    size_t num_blocks,
+                                    const struct SeatBlock *blocks,
+                                    size_t *num_spans) {
+    // Check the seats before touching any tile
+    *num_spans = num_seats;
+    for (size_t i = 0; i < num_seats; i++) {
+        if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 ||
+            ys[i] > event->cols) {
+            fprintf(stderr, "Invalid seat\n");
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < num_blocks; i++) {
+        const struct SeatBlock *block = &blocks[i];
+        if (block->row_from <= 0 || block->row_to > event->rows ||
+            block->col_from <= 0 || block->col_to > event->cols ||
+            block->row_from > block->row_to ||
+            block->col_from > block->col_to) {
+            fprintf(stderr, "Invalid seat\n");
+            return NULL;
+        }
+        *num_spans += block->row_to - block->row_from + 1;
+    }
+
+    // Each single seat and each row of a block is a span of seats
+    struct SeatSpan *spans = malloc(*num_spans * sizeof(struct SeatSpan));
+    if (spans == NULL) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        return NULL;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < num_seats; i++) {
+        spans[count++] = (struct SeatSpan){xs[i], ys[i], ys[i]};
+    }
+    for (size_t i = 0; i < num_blocks; i++) {
+        for (size_t row = blocks[i].row_from; row <= blocks[i].row_to; row++) {
+            spans[count++] =
+                (struct SeatSpan){row, blocks[i].col_from, blocks[i].col_to};
+        }
+    }
+
+    // Sort the spans by row and column and lock them in that order
+    qsort(spans, *num_spans, sizeof(struct SeatSpan), compare_spans);
+
+    // Look if any seat is repeated
+    for (size_t i = 1; i < *num_spans; i++) {
+        if (spans[i].row == spans[i - 1].row &&
+            spans[i].col_from <= spans[i - 1].col_to) {
+            free(spans);
+            return NULL;
+        }
+    }
+
+    return spans;
+}
+
+/// Gets the number of bytes ems_create() allocates for an event, before any
+/// of its seats are reserved.
+/// @param num_rows Number of rows of the event.
+/// @param num_tiles Number of tiles covering the event.
+/// @return Size of the event, SIZE_MAX if it does not fit in a size_t.
+static size_t event_memory(size_t num_rows, size_t num_tiles) {
+    size_t tiles, rows, bitmaps, total;
+    if (__builtin_mul_overflow(num_tiles ? num_tiles : 1,
+                               sizeof(struct SeatTile *), &tiles) ||
+        __builtin_mul_overflow(num_rows ? num_rows : 1,
+                               sizeof(struct RowIndex *), &rows) ||
+        __builtin_mul_overflow(num_rows / 64 + 1,
+                               2 * sizeof(atomic_uint_least64_t), &bitmaps) ||
+        __builtin_add_overflow(tiles, rows, &total) ||
+        __builtin_add_overflow(total, bitmaps + sizeof(struct Event),
+                               &total)) {
+        return SIZE_MAX;
+    }
+    return total;
 }
 
 // Initialize the event list
@@ -79,6 +1049,8 @@ void reset_event_list() {
     if (event_list != NULL) {
         free_list(event_list);
         event_list = create_list();
+        list_output_valid = 0;
+        atomic_fetch_add(&event_list_generation, 1);
     }
 }
 
@@ -89,9 +1061,50 @@ int ems_terminate() {
         return 1;
     }
     free_list(event_list);
+    event_list = NULL;
+    atomic_fetch_add(&event_list_generation, 1);
+
+    free(list_output.data);
+    list_output = (struct Output){NULL, 0, 0};
+    list_output_valid = 0;
+    return 0;
+}
+
+// Resolve an event, reusing the thread's handle when it is still current
+int ems_open_event(unsigned int event_id, struct EventHandle *handle) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    unsigned int generation = atomic_load(&event_list_generation);
+    size_t slot = event_id % EVENT_CACHE_SIZE;
+    if (ems_handle_valid(&event_cache[slot]) &&
+        event_cache[slot].event->id == event_id) {
+        *handle = event_cache[slot];
+        return 0;
+    }
+
+    // Lock the event list before reading the shared data
+    pthread_rwlock_rdlock(&event_list_rwlock);
+    struct Event *event = get_event_with_delay(event_id);
+    pthread_rwlock_unlock(&event_list_rwlock);
+
+    // Events that do not exist yet are looked up again next time
+    if (event == NULL) {
+        return 1;
+    }
+
+    *handle = (struct EventHandle){event, generation};
+    event_cache[slot] = *handle;
     return 0;
 }
 
+int ems_handle_valid(const struct EventHandle *handle) {
+    return handle->event != NULL &&
+           handle->generation == atomic_load(&event_list_generation);
+}
+
 // Create an event
 int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
     if (event_list == NULL) {
@@ -108,45 +1121,88 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
         return 1;
     }
 
+    // Reject dimensions whose seat count does not fit in memory
+    if (num_cols != 0 && num_rows > SIZE_MAX / num_cols) {
+        fprintf(stderr, "Invalid event dimensions\n");
+        pthread_rwlock_unlock(&event_list_rwlock);
+        return 1;
+    }
+
+    // Seats are allocated a tile at a time, on their first reservation
+    size_t tile_cols = (num_cols + TILE_COLS - 1) / TILE_COLS;
+    size_t num_tiles = (num_rows + TILE_ROWS - 1) / TILE_ROWS * tile_cols;
+
+    // Admit the event only if its tables and row counters fit in the budget
+    size_t memory = event_memory(num_rows, num_tiles);
+    if (contention_top() > 0 &&
+        __builtin_add_overflow(memory, contention_memory(num_rows), &memory)) {
+        memory = SIZE_MAX;
+    }
+    if (memory_charge(memory) != 0) {
+        fprintf(stderr, "Event exceeds memory budget\n");
+        pthread_rwlock_unlock(&event_list_rwlock);
+        return 1;
+    }
+
     struct Event *event = malloc(sizeof(struct Event));
 
     if (event == NULL) {
         fprintf(stderr, "Error allocating memory for event\n");
+        memory_release(memory);
         pthread_rwlock_unlock(&event_list_rwlock);
         return 1;
     }
 
     event->id = event_id;
+    event->memory = memory;
     event->rows = num_rows;
     event->cols = num_cols;
-    event->reservations = 0;
-    event->data = malloc(num_rows * num_cols * sizeof(unsigned int));
-
-    // Initialize mutexes for each seat
-    event->mutexes = malloc(num_rows * num_cols * sizeof(pthread_mutex_t));
-    for (size_t i = 0; i < num_rows * num_cols; i++) {
-        pthread_mutex_init(&event->mutexes[i], NULL);
-    }
-
-    if (event->data == NULL) {
+    atomic_init(&event->reservations, 0);
+    atomic_init(&event->booked_seats, 0);
+    event->reservation_seats = NULL;
+    event->reservation_seats_cap = 0;
+    affinity_current(&event->home_cpu, &event->home_node);
+    atomic_init(&event->version, 0);
+    event->show_output = (struct Output){NULL, 0, 0};
+    event->show_output_version = 0;
+    event->contention =
+        contention_top() > 0 ? contention_create(num_rows, num_cols) : NULL;
+
+    event->tile_cols = tile_cols;
+    event->num_tiles = num_tiles;
+    event->tiles = calloc(event->num_tiles ? event->num_tiles : 1,
+                          sizeof(struct SeatTile *));
+    event->row_index =
+        calloc(num_rows ? num_rows : 1, sizeof(struct RowIndex *));
+    event->dirty_rows =
+        calloc(num_rows / 64 + 1, sizeof(atomic_uint_least64_t));
+    event->reserved_rows =
+        calloc(num_rows / 64 + 1, sizeof(atomic_uint_least64_t));
+
+    pthread_mutex_init(&event->tile_lock, NULL);
+    pthread_rwlock_init(&event->lock, NULL);
+
+    if (event->tiles == NULL || event->row_index == NULL ||
+        event->dirty_rows == NULL || event->reserved_rows == NULL ||
+        (contention_top() > 0 && event->contention == NULL)) {
         fprintf(stderr, "Error allocating memory for event data\n");
-        free(event);
+        free_event(event);
         pthread_rwlock_unlock(&event_list_rwlock);
         return 1;
     }
 
-    for (size_t i = 0; i < num_rows * num_cols; i++) {
-        event->data[i] = 0;
-    }
-
     if (append_to_list(event_list, event) != 0) {
         fprintf(stderr, "Error appending event to list\n");
-        free(event->data);
-        free(event);
+        free_event(event);
         pthread_rwlock_unlock(&event_list_rwlock);
         return 1;
     }
 
+    // The event list is locked for writing, so no LIST is rendering
+    list_output_valid = 0;
+
+    wal_log_create(event_id, num_rows, num_cols);
+
     pthread_rwlock_unlock(&event_list_rwlock);
     return 0;
 }
@@ -154,152 +1210,641 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
 // Reserve seats
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs,
                 size_t *ys) {
+    return ems_reserve_blocks(event_id, num_seats, xs, ys, 0, NULL);
+}
+
+// Reserve seats and blocks of seats
+int ems_reserve_blocks(unsigned int event_id, size_t num_seats, size_t *xs,
+                       size_t *ys, size_t num_blocks,
+                       const struct SeatBlock *blocks) {
     if (event_list == NULL) {
         fprintf(stderr, "EMS state must be initialized\n");
         return 1;
     }
 
-    // Lock the event list before reading the shared data
-    pthread_rwlock_rdlock(&event_list_rwlock);
-
-    struct Event *event = get_event_with_delay(event_id);
-
+    struct Event *event = open_event(event_id);
     if (event == NULL) {
         fprintf(stderr, "Event not found\n");
-        pthread_rwlock_unlock(&event_list_rwlock);
         return 1;
     }
 
-    pthread_rwlock_unlock(&event_list_rwlock);
+    size_t num_spans;
+    struct SeatSpan *spans =
+        build_spans(event, num_seats, xs, ys, num_blocks, blocks, &num_spans);
+    if (spans == NULL) {
+        return 1;
+    }
 
-    unsigned int reservation_id = ++event->reservations;
+    struct EventSpans group = {event, num_spans, spans};
+    int result = reserve_groups(1, &group);
 
-    // Sort the seats by row and column and lock them in that order
-    for (size_t i = 0; i < num_seats; i++) {
-        for (size_t j = i + 1; j < num_seats; j++) {
-            if (xs[i] > xs[j] || (xs[i] == xs[j] && ys[i] > ys[j])) {
-                size_t temp = xs[i];
-                xs[i] = xs[j];
-                xs[j] = temp;
-
-                temp = ys[i];
-                ys[i] = ys[j];
-                ys[j] = temp;
+    free(spans);
+    return result;
+}
+
+// Reserve seats in several events at once
+int ems_reserve_multi(size_t num_events, const struct EventSeats *events) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    struct EventSpans *groups = calloc(num_events, sizeof(struct EventSpans));
+    if (groups == NULL) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        return 1;
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < num_events && result == 0; i++) {
+        groups[i].event = open_event(events[i].event_id);
+        if (groups[i].event == NULL) {
+            fprintf(stderr, "Event not found\n");
+            result = 1;
+        }
+    }
+
+    for (size_t i = 0; i < num_events && result == 0; i++) {
+        groups[i].spans = build_spans(
+            groups[i].event, events[i].num_seats, events[i].xs, events[i].ys,
+            events[i].num_blocks, events[i].blocks, &groups[i].num_spans);
+        result = groups[i].spans == NULL;
+    }
+
+    // Lock the events in id order, so that two reservations sharing events
+    // never wait on each other in a cycle
+    if (result == 0) {
+        qsort(groups, num_events, sizeof(struct EventSpans), compare_groups);
+
+        for (size_t i = 1; i < num_events; i++) {
+            if (groups[i].event == groups[i - 1].event) {
+                fprintf(stderr, "Event repeated in reservation\n");
+                result = 1;
+                break;
             }
         }
     }
 
-    // Look if any seat is repeated
-    for (size_t i = 0; i < num_seats; i++) {
-        for (size_t j = i + 1; j < num_seats; j++) {
-            if (xs[i] == xs[j] && ys[i] == ys[j]) {
+    if (result == 0) {
+        result = reserve_groups(num_events, groups);
+    }
+
+    for (size_t i = 0; i < num_events; i++) {
+        free(groups[i].spans);
+    }
+    free(groups);
+    return result;
+}
+
+/// Creates reservations that are all for the same event, looking the event
+/// up once and holding its lock across all of them.
+/// @param num_requests Number of reservations.
+/// @param requests Seats of each reservation.
+/// @param results Set to the result of each reservation.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+static int reserve_event_batch(size_t num_requests,
+                               const struct EventSeats *requests,
+                               int *results) {
+    struct Event *event = open_event(requests[0].event_id);
+
+    if (event == NULL) {
+        for (size_t i = 0; i < num_requests; i++) {
+            fprintf(stderr, "Event not found\n");
+            results[i] = 1;
+        }
+        return 1;
+    }
+
+    int result = 0;
+    lock_event_for_reserve(event);
+
+    // Each reservation still succeeds or fails on its own, in order
+    for (size_t i = 0; i < num_requests; i++) {
+        struct EventSpans group = {event, 0, NULL};
+        group.spans = build_spans(event, requests[i].num_seats, requests[i].xs,
+                                  requests[i].ys, requests[i].num_blocks,
+                                  requests[i].blocks, &group.num_spans);
+
+        results[i] = group.spans == NULL || create_group_tiles(&group) != 0 ||
+                     reserve_locked_groups(1, &group) != 0;
+        result |= results[i];
+        free(group.spans);
+    }
+
+    pthread_rwlock_unlock(&event->lock);
+    return result;
+}
+
+// Reserve seats for several requests, batching those of the same event
+int ems_reserve_batch(size_t num_requests, const struct EventSeats *requests,
+                      int *results) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        for (size_t i = 0; i < num_requests; i++) {
+            results[i] = 1;
+        }
+        return 1;
+    }
+
+    int result = 0;
+    size_t first = 0;
+    while (first < num_requests) {
+        size_t last = first + 1;
+        while (last < num_requests &&
+               requests[last].event_id == requests[first].event_id) {
+            last++;
+        }
+
+        result |= reserve_event_batch(last - first, requests + first,
+                                      results + first);
+        first = last;
+    }
+    return result;
+}
+
+// Reserve the best block of adjacent free seats
+int ems_reserve_best(unsigned int event_id, size_t num_seats, int fd) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    struct Event *event = open_event(event_id);
+    if (event == NULL) {
+        fprintf(stderr, "Event not found\n");
+        return 1;
+    }
+
+    if (num_seats == 0 || num_seats > event->cols) {
+        fprintf(stderr, "Invalid number of seats\n");
+        return 1;
+    }
+
+    // Keep every other reservation out between the search and the booking
+    uint64_t wait_start = trace_now();
+    pthread_rwlock_wrlock(&event->lock);
+    trace_wait("event lock", wait_start);
+
+    // The front-most row with a long enough run wins; rows that were never
+    // reserved are all free and need no index
+    struct SeatSpan span = {0, 0, 0};
+    for (size_t row = 1; row <= event->rows; row++) {
+        size_t col = 1;
+        if (row_was_reserved(event, row)) {
+            struct RowIndex *index = get_or_create_row_index(event, row);
+            if (index == NULL) {
+                fprintf(stderr, "Error allocating memory for event data\n");
+                pthread_rwlock_unlock(&event->lock);
                 return 1;
             }
+            col = row_index_find(index, num_seats);
+        }
+        if (col != 0) {
+            span = (struct SeatSpan){row, col, col + num_seats - 1};
+            break;
         }
     }
 
-    // Lock seat mutexes
-    for (size_t i = 0; i < num_seats; i++) {
-        pthread_mutex_lock(&event->mutexes[seat_index(event, xs[i], ys[i])]);
+    if (span.row == 0) {
+        fprintf(stderr, "No block of free seats\n");
+        pthread_rwlock_unlock(&event->lock);
+        return 1;
+    }
+
+    if (create_span_tiles(event, &span) != 0) {
+        fprintf(stderr, "Error allocating memory for event data\n");
+        pthread_rwlock_unlock(&event->lock);
+        return 1;
+    }
+
+    unsigned int reservation_id;
+    struct EventSpans group = {event, 1, &span};
+    if (new_reservations(1, &group, &reservation_id) != 0) {
+        pthread_rwlock_unlock(&event->lock);
+        return 1;
     }
 
-    size_t i = 0;
-    for (; i < num_seats; i++) {
-        size_t row = xs[i];
-        size_t col = ys[i];
+    fill_span_with_delay(event, &span, reservation_id);
+    wal_log_reserve(event->id, reservation_id, 1, &span);
 
-        if (row <= 0 || row > event->rows || col <= 0 || col > event->cols) {
-            fprintf(stderr, "Invalid seat\n");
-            break;
+    pthread_rwlock_unlock(&event->lock);
+
+    // Tell the client which seats it got
+    char buffer[128];
+    int length =
+        snprintf(buffer, sizeof(buffer), "Reserved %u: (%zu,%zu)-(%zu,%zu)\n",
+                 reservation_id, span.row, span.col_from, span.row,
+                 span.col_to);
+    io_write(fd, buffer, (size_t)length);
+    return 0;
+}
+
+// Restore logged reservations, all of them or none
+int ems_replay_reserve(size_t num_events, const unsigned int *event_ids,
+                       const unsigned int *reservation_ids,
+                       const size_t *num_spans,
+                       const struct SeatSpan *const *spans) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    struct Event **events = malloc(num_events * sizeof(struct Event *));
+    if (events == NULL) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        return 1;
+    }
+
+    // Check every event and seat before any seat is taken
+    int result = 0;
+    pthread_rwlock_rdlock(&event_list_rwlock);
+    for (size_t i = 0; i < num_events && result == 0; i++) {
+        events[i] = get_event(event_list, event_ids[i]);
+        if (events[i] == NULL) {
+            fprintf(stderr, "Event not found\n");
+            result = 1;
         }
+    }
+    pthread_rwlock_unlock(&event_list_rwlock);
 
-        if (*get_seat_with_delay(event, seat_index(event, row, col)) != 0) {
-            fprintf(stderr, "Seat already reserved\n");
+    for (size_t i = 0; i < num_events && result == 0; i++) {
+        for (size_t j = 0; j < num_spans[i]; j++) {
+            const struct SeatSpan *span = &spans[i][j];
+            if (span->row <= 0 || span->row > events[i]->rows ||
+                span->col_from <= 0 || span->col_to > events[i]->cols ||
+                span->col_from > span->col_to) {
+                fprintf(stderr, "Invalid seat\n");
+                result = 1;
+                break;
+            }
+        }
+    }
 
-            break;
+    // A tile left over by a failed allocation only holds free seats
+    for (size_t i = 0; i < num_events && result == 0; i++) {
+        for (size_t j = 0; j < num_spans[i] && result == 0; j++) {
+            if (create_span_tiles(events[i], &spans[i][j]) != 0) {
+                fprintf(stderr, "Error allocating memory for event data\n");
+                result = 1;
+            }
         }
+    }
 
-        *get_seat_with_delay(event, seat_index(event, row, col)) =
-            reservation_id;
+    // So are the copies kept for CANCEL and room for their ids
+    struct Reservation **copies =
+        result == 0 ? calloc(num_events, sizeof(struct Reservation *)) : NULL;
+    if (result == 0 && copies == NULL) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        result = 1;
     }
 
-    // Lock reservation id lock before reading the shared data, needed to
-    // assure a decrement if reservation fails.
     pthread_mutex_lock(&reservation_id_lock);
+    for (size_t i = 0; i < num_events && result == 0; i++) {
+        if (grow_reservation_index(events[i], reservation_ids[i]) != 0 ||
+            (copies[i] = copy_reservation(num_spans[i], spans[i])) == NULL) {
+            result = 1;
+        }
+    }
+    pthread_mutex_unlock(&reservation_id_lock);
 
-    // If the reservation was not successful, free the seats that were reserved.
-    if (i < num_seats) {
-        event->reservations--;
-        for (size_t j = 0; j < i; j++) {
-            *get_seat_with_delay(event, seat_index(event, xs[j], ys[j])) = 0;
+    // Replay runs before any worker, so no seat locks are needed
+    for (size_t i = 0; i < num_events && result == 0; i++) {
+        for (size_t j = 0; j < num_spans[i]; j++) {
+            fill_span(events[i], &spans[i][j], reservation_ids[i]);
         }
-        pthread_mutex_unlock(&reservation_id_lock);
 
-        // Unlock seat mutexes
-        for (size_t j = 0; j < num_seats; j++) {
-            pthread_mutex_unlock(
-                &event->mutexes[seat_index(event, xs[j], ys[j])]);
+        pthread_mutex_lock(&reservation_id_lock);
+        if (reservation_ids[i] > atomic_load_explicit(&events[i]->reservations,
+                                                      memory_order_relaxed)) {
+            atomic_store_explicit(&events[i]->reservations, reservation_ids[i],
+                                  memory_order_relaxed);
         }
+        events[i]->reservation_seats[reservation_ids[i]] = copies[i];
+        copies[i] = NULL;
+        pthread_mutex_unlock(&reservation_id_lock);
+    }
+
+    for (size_t i = 0; copies != NULL && i < num_events; i++) {
+        free_reservation(copies[i]);
+    }
+    free(copies);
+    free(events);
+    return result;
+}
+
+// Cancel a reservation
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    struct Event *event = open_event(event_id);
+    if (event == NULL) {
+        fprintf(stderr, "Event not found\n");
         return 1;
     }
+
+    // Take the reservation out of the index, so it is only cancelled once
+    struct Reservation *reservation = NULL;
+    pthread_mutex_lock(&reservation_id_lock);
+    if (reservation_id < event->reservation_seats_cap) {
+        reservation = event->reservation_seats[reservation_id];
+        event->reservation_seats[reservation_id] = NULL;
+    }
     pthread_mutex_unlock(&reservation_id_lock);
 
-    // Unlock seat mutexes
-    for (size_t j = 0; j < num_seats; j++) {
-        pthread_mutex_unlock(&event->mutexes[seat_index(event, xs[j], ys[j])]);
+    if (reservation == NULL) {
+        fprintf(stderr, "Reservation not found\n");
+        return 1;
+    }
+
+    uint64_t wait_start = trace_now();
+    pthread_rwlock_rdlock(&event->lock);
+    trace_wait("event lock", wait_start);
+
+    // The spans were sorted when reserved, so they are locked in the same
+    // order as ems_reserve() locks seats
+    for (size_t i = 0; i < reservation->num_spans; i++) {
+        lock_span(event, &reservation->spans[i]);
+    }
+
+    for (size_t i = 0; i < reservation->num_spans; i++) {
+        fill_span_with_delay(event, &reservation->spans[i], 0);
     }
+
+    wal_log_cancel(event_id, reservation_id);
+
+    for (size_t i = 0; i < reservation->num_spans; i++) {
+        unlock_span(event, &reservation->spans[i]);
+    }
+
+    pthread_rwlock_unlock(&event->lock);
+
+    free_reservation(reservation);
     return 0;
 }
 
 // Show the event
 int ems_show(unsigned int event_id, int fd) {
+    return ems_show_repeat(event_id, fd, 1);
+}
+
+// Show the event several times from a single render
+int ems_show_repeat(unsigned int event_id, int fd, size_t count) {
     if (event_list == NULL) {
         fprintf(stderr, "EMS state must be initialized\n");
         return 1;
     }
 
-    // Lock the event list before reading the shared data
-    pthread_rwlock_rdlock(&event_list_rwlock);
+    struct Event *event = open_event(event_id);
+    if (event == NULL) {
+        fprintf(stderr, "Event not found\n");
+        return 1;
+    }
 
-    struct Event *event = get_event_with_delay(event_id);
+    // Lock the whole event before reading the shared data; this waits for
+    // every reservation in progress, as locking each seat would
+    uint64_t wait_start = trace_now();
+    pthread_rwlock_wrlock(&event->lock);
+    trace_wait("event lock", wait_start);
+
+    // Render the event again only if it changed since it was last rendered
+    unsigned int version =
+        atomic_load_explicit(&event->version, memory_order_relaxed);
+    struct Output output = event->show_output;
+    if (output.data == NULL || event->show_output_version != version) {
+        output = (struct Output){NULL, 0, 0};
+        if (render_event(event, &output) != 0) {
+            fprintf(stderr, "Error allocating memory for output\n");
+            free(output.data);
+            pthread_rwlock_unlock(&event->lock);
+            return 1;
+        }
+
+        // The render is kept for the next SHOW only if it fits in the budget
+        memory_release(event->show_output.cap);
+        free(event->show_output.data);
+        event->show_output = (struct Output){NULL, 0, 0};
+        if (memory_charge(output.cap) == 0) {
+            event->show_output = output;
+            event->show_output_version = version;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        io_write(fd, output.data, output.len);
+    }
+
+    if (output.data != event->show_output.data) {
+        free(output.data);
+    }
+
+    // The next SHOWDIFF starts from this view
+    for (size_t i = 0; i <= event->rows / 64; i++) {
+        atomic_store_explicit(&event->dirty_rows[i], 0, memory_order_relaxed);
+    }
 
+    pthread_rwlock_unlock(&event->lock);
+    return 0;
+}
+
+// Show a rectangle of the event, locking only its seats
+int ems_show_range(unsigned int event_id, int fd,
+                   const struct SeatBlock *range) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    struct Event *event = open_event(event_id);
     if (event == NULL) {
         fprintf(stderr, "Event not found\n");
-        pthread_rwlock_unlock(&event_list_rwlock);
         return 1;
     }
 
-    pthread_rwlock_unlock(&event_list_rwlock);
+    // Without a column range, whole rows are shown
+    struct SeatBlock block = *range;
+    if (block.col_from == 0) {
+        block.col_from = 1;
+        block.col_to = event->cols;
+    }
+
+    if (block.row_from <= 0 || block.row_from > block.row_to ||
+        block.row_to > event->rows || block.col_from <= 0 ||
+        block.col_from > block.col_to || block.col_to > event->cols) {
+        fprintf(stderr, "Invalid range\n");
+        return 1;
+    }
+
+    // Lock the rectangle like a reservation would: the event for reading,
+    // then its seats in (row, column) order, so the view is consistent
+    // while reservations elsewhere in the event go on. Seats of missing
+    // tiles are free and have no lock, and showing them allocates nothing
+    lock_event_for_reserve(event);
+    struct BlockTiles snapshot;
+    if (snapshot_block_tiles(event, &block, &snapshot) != 0) {
+        fprintf(stderr, "Error allocating memory for output\n");
+        pthread_rwlock_unlock(&event->lock);
+        return 1;
+    }
+
+    // A tile allocated before the seats were locked may hold a reservation
+    // that also took locked seats, so lock again with it. Any tile allocated
+    // later only holds reservations made after this view, and reads as free
+    lock_block_seats(event, &block, &snapshot, 1);
+    while (refresh_block_tiles(event, &snapshot, 0)) {
+        lock_block_seats(event, &block, &snapshot, 0);
+        refresh_block_tiles(event, &snapshot, 1);
+        lock_block_seats(event, &block, &snapshot, 1);
+    }
+
+    struct Output output = {NULL, 0, 0};
+    int result = render_block(event, &block, &snapshot, &output);
 
-    // Lock every seat mutex before reading the shared data
-    for (size_t i = 0; i < event->rows * event->cols; i++) {
-        pthread_mutex_lock(&event->mutexes[i]);
+    lock_block_seats(event, &block, &snapshot, 0);
+    pthread_rwlock_unlock(&event->lock);
+    free(snapshot.tiles);
+
+    if (result != 0) {
+        fprintf(stderr, "Error allocating memory for output\n");
+    } else {
+        io_write(fd, output.data, output.len);
     }
 
-    for (size_t i = 1; i <= event->rows; i++) {
-        for (size_t j = 1; j <= event->cols; j++) {
-            unsigned int *seat =
-                get_seat_with_delay(event, seat_index(event, i, j));
+    free(output.data);
+    return result;
+}
+
+// Show the rows changed since the event was last shown
+int ems_show_diff(unsigned int event_id, int fd) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
 
-            char seat_str[64];
-            snprintf(seat_str, 64, "%u ", *seat);
+    struct Event *event = open_event(event_id);
+    if (event == NULL) {
+        fprintf(stderr, "Event not found\n");
+        return 1;
+    }
 
-            // Write the formatted seat string to the file
-            write(fd, seat_str, strlen(seat_str));
+    uint64_t wait_start = trace_now();
+    pthread_rwlock_wrlock(&event->lock);
+    trace_wait("event lock", wait_start);
+
+    // Only visit the rows whose bit is set
+    struct Output output = {NULL, 0, 0};
+    int result = 0;
+    for (size_t i = 0; i <= event->rows / 64; i++) {
+        uint_least64_t dirty = atomic_exchange_explicit(
+            &event->dirty_rows[i], 0, memory_order_relaxed);
+
+        while (dirty != 0 && result == 0) {
+            size_t row = i * 64 + (size_t)__builtin_ctzll(dirty) + 1;
+            dirty &= dirty - 1;
+
+            char row_str[32];
+            int length = snprintf(row_str, sizeof(row_str), "%zu: ", row);
+            result = append_output(&output, row_str, (size_t)length) ||
+                     render_row(event, row, &output);
         }
+    }
 
-        // Add a newline after each row
-        char newline = '\n';
-        write(fd, &newline, 1);
+    pthread_rwlock_unlock(&event->lock);
+
+    if (result != 0) {
+        fprintf(stderr, "Error allocating memory for output\n");
+    } else {
+        io_write(fd, output.data, output.len);
+    }
+
+    free(output.data);
+    return result;
+}
+
+// Print the occupancy of an event
+int ems_stats(unsigned int event_id, int fd) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
     }
 
-    // Unlock the seat mutex after reading the shared data
-    for (size_t i = 0; i < event->rows * event->cols; i++) {
-        pthread_mutex_unlock(&event->mutexes[i]);
+    struct Event *event = open_event(event_id);
+    if (event == NULL) {
+        fprintf(stderr, "Event not found\n");
+        return 1;
+    }
+
+    // Counters and bitmaps are read without locking any seat
+    size_t booked =
+        atomic_load_explicit(&event->booked_seats, memory_order_relaxed);
+
+    char buffer[128];
+    int length = snprintf(buffer, sizeof(buffer),
+                          "Event %u: %zu booked, %zu free, %u reservations\n",
+                          event->id, booked,
+                          event->rows * event->cols - booked,
+                          atomic_load_explicit(&event->reservations,
+                                               memory_order_relaxed));
+    io_write(fd, buffer, (size_t)length);
+
+    // Report where the event was created when placement is controlled
+    if (affinity_enabled()) {
+        length = snprintf(buffer, sizeof(buffer),
+                          "Placement: CPU %d, node %d\n", event->home_cpu,
+                          event->home_node);
+        io_write(fd, buffer, (size_t)length);
+    }
+
+    // Rows that were never reserved are left out
+    for (size_t row = 1; row <= event->rows; row++) {
+        if (!row_was_reserved(event, row)) {
+            continue;
+        }
+
+        size_t row_booked = 0;
+        for (size_t col = 1; col <= event->cols; col += TILE_COLS) {
+            struct SeatTile *tile = get_tile(event, row, col);
+            if (tile != NULL) {
+                row_booked += (size_t)__builtin_popcountll(atomic_load_explicit(
+                    &tile->booked[(row - 1) % TILE_ROWS],
+                    memory_order_relaxed));
+            }
+        }
+
+        length = snprintf(buffer, sizeof(buffer), "Row %zu: %zu/%zu\n", row,
+                          row_booked, event->cols);
+        io_write(fd, buffer, (size_t)length);
     }
+
     return 0;
 }
 
+void ems_set_show_format(enum ShowFormat format) { show_format = format; }
+
+// Report the contention of every event, in creation order
+int ems_contention_report(int fd) {
+    if (event_list == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    pthread_rwlock_rdlock(&event_list_rwlock);
+
+    int result = 0;
+    for (struct ListNode *current = event_list->head; current != NULL;
+         current = current->next) {
+        struct Event *event = current->event;
+        if (event->contention != NULL) {
+            result |= contention_report(event->contention, event->id, fd);
+        }
+    }
+
+    pthread_rwlock_unlock(&event_list_rwlock);
+    return result;
+}
+
 // List all events
 int ems_list_events(int fd) {
     if (event_list == NULL) {
@@ -309,26 +1854,50 @@ int ems_list_events(int fd) {
 
     pthread_rwlock_rdlock(&event_list_rwlock);
 
-    if (event_list->head == NULL) {
-        write(fd, "No events\n", strlen("No events\n"));
-        pthread_rwlock_unlock(&event_list_rwlock);
-        return 0;
-    }
+    // Concurrent LISTs share the rendered output
+    pthread_mutex_lock(&list_output_lock);
+
+    if (!list_output_valid) {
+        list_output.len = 0;
+
+        int result = 0;
+        if (event_list->head == NULL) {
+            result = append_output(&list_output, "No events\n",
+                                   strlen("No events\n"));
+        }
+
+        struct ListNode *current = event_list->head;
+        while (current != NULL && result == 0) {
+            char buffer[64];
+            int length = snprintf(buffer, sizeof(buffer), "Event: %u\n",
+                                  (current->event)->id);
+            result = append_output(&list_output, buffer, (size_t)length);
+            current = current->next;
+        }
 
-    struct ListNode *current = event_list->head;
-    while (current != NULL) {
-        char buffer[64];
-        int length = snprintf(buffer, sizeof(buffer), "Event: %u\n",
-                              (current->event)->id);
-        write(fd, buffer, (size_t)length);
-        current = current->next;
+        if (result != 0) {
+            fprintf(stderr, "Error allocating memory for output\n");
+            pthread_mutex_unlock(&list_output_lock);
+            pthread_rwlock_unlock(&event_list_rwlock);
+            return 1;
+        }
+        list_output_valid = 1;
     }
+
+    io_write(fd, list_output.data, list_output.len);
+
+    pthread_mutex_unlock(&list_output_lock);
     pthread_rwlock_unlock(&event_list_rwlock);
     return 0;
 }
 
 // Wait for a delay
 void ems_wait(unsigned int delay_ms) {
+    if (vclock_enabled()) {
+        vclock_advance(delay_ms);
+        return;
+    }
+
     struct timespec delay = delay_to_timespec(delay_ms);
     nanosleep(&delay, NULL);
 }
@@ -338,13 +1907,22 @@ int ems_help(int fd) {
     char *help_str = "Available commands:\n"
                      "  CREATE <event_id> <num_rows> <num_columns>\n"
                      "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+                     "  RESERVE <event_id> [(<x1>,<y1>)-(<x2>,<y2>) ...]\n"
+                     "  RESERVE_BEST <event_id> <num_seats>\n"
+                     "  RESERVE_MULTI <event_id> [(<x1>,<y1>) ...] "
+                     "<event_id> [...] ...\n"
+                     "  CANCEL <event_id> <reservation_id>\n"
                      "  SHOW <event_id>\n"
+                     "  SHOW <event_id> <row_from>-<row_to> "
+                     "[<col_from>-<col_to>]\n"
+                     "  SHOWDIFF <event_id>\n"
+                     "  STATS <event_id>\n"
                      "  LIST\n"
                      "  WAIT <delay_ms> [thread_id]\n"
                      "  BARRIER\n"
                      "  HELP\n";
 
-    write(fd, help_str, strlen(help_str));
+    io_write(fd, help_str, strlen(help_str));
 
     return 0;
 }
\ No newline at end of file
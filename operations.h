@@ -3,6 +3,45 @@
 
 #include <stddef.h>
 
+/// Rectangle of seats, from (row_from, col_from) to (row_to, col_to).
+struct SeatBlock {
+    size_t row_from;
+    size_t col_from;
+    size_t row_to;
+    size_t col_to;
+};
+
+/// Seats of a row, from col_from to col_to.
+struct SeatSpan {
+    size_t row;
+    size_t col_from;
+    size_t col_to;
+};
+
+/// Seats of one event in a reservation spanning several events.
+struct EventSeats {
+    unsigned int event_id;
+    size_t num_seats;         // Number of single seats.
+    size_t *xs;               // Rows of the single seats.
+    size_t *ys;               // Columns of the single seats.
+    size_t num_blocks;        // Number of blocks of seats.
+    struct SeatBlock *blocks; // Blocks of seats.
+};
+
+/// Formats SHOW prints events in.
+enum ShowFormat {
+    SHOW_TEXT,   // One line per row, one reservation id per seat.
+    SHOW_BINARY, // One binary record per event, described in ems_show().
+};
+
+struct Event;
+
+/// Event resolved by ems_open_event(), valid until the event list is reset.
+struct EventHandle {
+    struct Event *event;     // Resolved event.
+    unsigned int generation; // Generation of the event list it belongs to.
+};
+
 /// Initializes the EMS state.
 /// @param delay_ms State access delay in milliseconds.
 /// @return 0 if the EMS state was initialized successfully, 1 otherwise.
@@ -11,6 +50,19 @@ int ems_init(unsigned int delay_ms);
 /// Destroys the EMS state.
 int ems_terminate();
 
+/// Resolves an event into a handle. Each thread keeps the handles of the
+/// events it used recently, so reopening a hot event skips the costly
+/// lookup; every operation below resolves its event this way.
+/// @param event_id Id of the event to resolve.
+/// @param handle Set to the handle of the event.
+/// @return 0 if the event was found, 1 otherwise.
+int ems_open_event(unsigned int event_id, struct EventHandle *handle);
+
+/// Checks whether a handle still refers to a live event. Handles become
+/// stale when the event list is reset or the EMS state destroyed.
+/// @return 1 if the handle can be used, 0 otherwise.
+int ems_handle_valid(const struct EventHandle *handle);
+
 /// Creates a new event with the given id and dimensions.
 /// @param event_id Id of the event to be created.
 /// @param num_rows Number of rows of the event to be created.
@@ -27,11 +79,112 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs,
                 size_t *ys);
 
-/// Prints the given event.
+/// Creates a new reservation for the given event, made of single seats and
+/// rectangular blocks of seats.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of single seats to reserve.
+/// @param xs Array of rows of the single seats to reserve.
+/// @param ys Array of columns of the single seats to reserve.
+/// @param num_blocks Number of blocks to reserve.
+/// @param blocks Array of blocks to reserve.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_blocks(unsigned int event_id, size_t num_seats, size_t *xs,
+                       size_t *ys, size_t num_blocks,
+                       const struct SeatBlock *blocks);
+
+/// Creates one reservation in each of several events, atomically: if any
+/// seat is taken or invalid, no event is changed.
+/// @param num_events Number of events.
+/// @param events Seats to reserve in each event. Each event may appear once.
+/// @return 0 if the reservations were created successfully, 1 otherwise.
+int ems_reserve_multi(size_t num_events, const struct EventSeats *events);
+
+/// Creates several reservations, each succeeding or failing on its own as
+/// with ems_reserve_blocks(), in order. Consecutive requests for the same
+/// event share a single lookup of the event and a single hold of its lock.
+/// @param num_requests Number of reservations.
+/// @param requests Seats of each reservation.
+/// @param results Set to 0 for each reservation created, 1 otherwise.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+int ems_reserve_batch(size_t num_requests, const struct EventSeats *requests,
+                      int *results);
+
+/// Reserves the first block of adjacent free seats of the given length, in
+/// the front-most row that has one, and prints the reserved block.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of adjacent seats to reserve.
+/// @param fd File descriptor to print the reserved block to.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, int fd);
+
+/// Cancels a reservation, freeing all its seats.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id of the reservation to cancel.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Restores the reservations of a write-ahead log record, one per event, all
+/// of them or none: no seat is taken unless every event exists and every
+/// span fits in its event.
+/// @param num_events Number of events reserved in.
+/// @param event_ids Id of each event.
+/// @param reservation_ids Id each reservation was originally given.
+/// @param num_spans Number of reserved spans in each event.
+/// @param spans Array of reserved spans of each event.
+/// @return 0 if the reservations were restored successfully, 1 otherwise.
+int ems_replay_reserve(size_t num_events, const unsigned int *event_ids,
+                       const unsigned int *reservation_ids,
+                       const size_t *num_spans,
+                       const struct SeatSpan *const *spans);
+
+/// Prints the given event, in the format set with ems_set_show_format().
+/// A binary record is a SHOW_RECORD_MARKER byte, which text output never
+/// contains, and a SHOW_RECORD_TYPE byte, followed by LEB128 varints: the
+/// event id, the number of rows and of columns, and then runs of seats in
+/// row major order, each a reservation id (0 for free) and a run length.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
 int ems_show(unsigned int event_id, int fd);
 
+/// Prints the given event several times, from a single lookup and render, as
+/// back-to-back calls to ems_show() with no change in between would.
+/// @param event_id Id of the event to print.
+/// @param count Number of times to print it.
+/// @return 0 if the event was printed successfully, 1 otherwise.
+int ems_show_repeat(unsigned int event_id, int fd, size_t count);
+
+/// Prints a rectangle of seats of the given event, in the format set with
+/// ems_set_show_format(), as ems_show() prints an event of its size. Only
+/// the seats of the rectangle are locked, like a reservation locks its
+/// seats, and the next ems_show_diff() still reports the rows it printed.
+/// Seats of tiles never reserved are printed as free, and no tile is
+/// allocated.
+/// @param event_id Id of the event to print.
+/// @param range Rows and columns to print, every column if col_from is 0.
+/// @return 0 if the seats were printed successfully, 1 otherwise.
+int ems_show_range(unsigned int event_id, int fd,
+                   const struct SeatBlock *range);
+
+/// Prints the rows of the given event that changed since it was last printed
+/// by ems_show() or ems_show_diff(), each prefixed by its row number.
+/// @param event_id Id of the event to print.
+/// @return 0 if the rows were printed successfully, 1 otherwise.
+int ems_show_diff(unsigned int event_id, int fd);
+
+/// Prints the number of taken and free seats of the given event, followed by
+/// the number of taken seats of each row that has been reserved.
+/// @param event_id Id of the event to print.
+/// @return 0 if the statistics were printed successfully, 1 otherwise.
+int ems_stats(unsigned int event_id, int fd);
+
+/// Prints the lock waits and failed reservations of every event created with
+/// contention counters, and its most contended rows and seats.
+/// @return 0 if the report was printed successfully, 1 otherwise.
+int ems_contention_report(int fd);
+
+/// Sets the format ems_show() prints events in. Defaults to SHOW_TEXT.
+void ems_set_show_format(enum ShowFormat format);
+
 /// Prints all the events.
 /// @return 0 if the events were printed successfully, 1 otherwise.
 int ems_list_events(int fd);
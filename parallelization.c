@@ -1,8 +1,17 @@
 // parallelization.c 
+#include "affinity.h"
 #include "constants.h"
+#include "contention.h"
+#include "jobsindex.h"
+#include "memio.h"
+#include "memory.h"
 #include "operations.h"
 #include "parallelization.h"
 #include "parser.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "vclock.h"
+#include "wal.h"
 #include <dirent.h>
 #include <fcntl.h>
 #include <pthread.h>
@@ -14,8 +23,54 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+int max_thr = 1;
+int max_proc =1;
+int max_carriers = 0;
+
 pthread_mutex_t output_file_lock = PTHREAD_MUTEX_INITIALIZER;
 
+// Lock the output file, tracing the wait
+static void lock_output_file() {
+    uint64_t wait_start = trace_now();
+    pthread_mutex_lock(&output_file_lock);
+    trace_wait("output file lock", wait_start);
+}
+
+// Name of a command in the trace
+static const char *command_name(enum Command cmd) {
+    switch (cmd) {
+    case CMD_CREATE:
+        return "CREATE";
+    case CMD_RESERVE:
+        return "RESERVE";
+    case CMD_RESERVE_BEST:
+        return "RESERVE_BEST";
+    case CMD_RESERVE_MULTI:
+        return "RESERVE_MULTI";
+    case CMD_CANCEL:
+        return "CANCEL";
+    case CMD_SHOW:
+        return "SHOW";
+    case CMD_SHOWDIFF:
+        return "SHOWDIFF";
+    case CMD_STATS:
+        return "STATS";
+    case CMD_LIST_EVENTS:
+        return "LIST";
+    case CMD_BARRIER:
+        return "BARRIER";
+    case CMD_WAIT:
+        return "WAIT";
+    case CMD_HELP:
+        return "HELP";
+    case CMD_EMPTY:
+    case CMD_INVALID:
+    case EOC:
+    default:
+        return "INVALID";
+    }
+}
+
 // Check if a file name has a given extension.
 int endsWith(const char *str, const char *suffix) {
     size_t str_len = strlen(str);
@@ -28,220 +83,570 @@ int endsWith(const char *str, const char *suffix) {
     return strcmp(str + (str_len - suffix_len), suffix) == 0;
 }
 
-// Get the line number at a given file offset.
-int get_line_number(int fd, off_t offset) {
-    char c;
-    off_t original_offset = lseek(fd, 0, SEEK_CUR);
+// Function to open the output file
+int open_output_file(const char *base_name, char argv[]) {
+    char out_file_path[PATH_MAX];
+    snprintf(out_file_path, sizeof(out_file_path), "%s/%s.out", argv,
+             base_name);
 
-    lseek(fd, 0, SEEK_SET);
+    int out_fd = open(out_file_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
 
-    int line_number = 1;
+    return out_fd;
+}
 
-    while (lseek(fd, 0, SEEK_CUR) < offset) {
-        if (read(fd, &c, 1) == 0) {
-            // Break if end of file is reached
-            break;
-        }
+// Function to replay and reopen the write-ahead log of a .jobs file
+int open_log_file(const char *base_name, char argv[]) {
+    char log_file_path[PATH_MAX];
+    snprintf(log_file_path, sizeof(log_file_path), "%s/%s.wal", argv,
+             base_name);
 
-        if (c == '\n') {
-            line_number++;
-        }
+    long replayed = wal_replay(log_file_path);
+    if (replayed < 0) {
+        fprintf(stderr, "Error replaying log\n");
+    } else if (replayed > 0) {
+        printf("Child process [%d] recovered %ld operations\n", getpid(),
+               replayed);
     }
 
-    lseek(fd, original_offset, SEEK_SET); // Restore the original offset
+    return wal_open(log_file_path);
+}
+
+// Function to write the trace of a .jobs file
+int write_trace_file(const char *base_name, char argv[]) {
+    char trace_file_path[PATH_MAX];
+    snprintf(trace_file_path, sizeof(trace_file_path), "%s/%s.trace.json",
+             argv, base_name);
 
-    return line_number;
+    return trace_close(trace_file_path);
 }
 
-// Function to open the output file
-int open_output_file(const char *base_name, char argv[]) {
-    char out_file_path[PATH_MAX];
-    snprintf(out_file_path, sizeof(out_file_path), "%s/%s.out", argv,
-             base_name);
+// Write the contention report of a .jobs file
+int write_contention_file(const char *base_name, char argv[]) {
+    char report_file_path[PATH_MAX];
+    snprintf(report_file_path, sizeof(report_file_path),
+             "%s/%s.contention", argv, base_name);
 
-    int out_fd = open(out_file_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int fd = open(report_file_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) {
+        perror("Error opening contention file");
+        return 1;
+    }
 
-    return out_fd;
+    int result = ems_contention_report(fd);
+    close(fd);
+    return result;
 }
 
-// Parses the content of a .jobs file
-void parse_jobs_file(int fd, int out_fd, int id) {
+// Reads the command on the thread's next line, if that line runs right after
+// the current one, with no line every thread runs in between. Returns EOC if
+// there is no such line.
+static enum Command peek_next_command(struct ThreadData *thread) {
+    const struct JobsIndex *index = thread->index;
+    size_t line = thread->next_line;
+    if (line >= index->num_lines ||
+        (thread->next_global < index->num_global &&
+         index->global_lines[thread->next_global] <= line)) {
+        return EOC;
+    }
+
+    io_seek(thread->fd, index->line_starts[line], SEEK_SET);
+    return get_next(thread->fd);
+}
+
+// Parses the thread's next line if it is a RESERVE of the given event, and
+// skips it. Returns 1 if it was parsed into seats, 0 otherwise.
+static int next_reserve(struct ThreadData *thread, unsigned int event_id,
+                        struct EventSeats *seats) {
+    if (peek_next_command(thread) != CMD_RESERVE ||
+        parse_reserve(thread->fd, &seats->event_id, &seats->xs, &seats->ys,
+                      &seats->num_seats, &seats->blocks,
+                      &seats->num_blocks) == 0) {
+        return 0;
+    }
 
-    // Reset the end of file flag
-    int eof_flag = 0;
+    if (seats->event_id != event_id) {
+        free(seats->xs);
+        free(seats->ys);
+        free(seats->blocks);
+        return 0;
+    }
 
-    // Current line number
-    int current_line = 0;
+    thread->next_line += (size_t)max_thr;
+    return 1;
+}
 
-    // Process each command in the file until the end is reached
-    while (!eof_flag) {
-        enum Command cmd = get_next(fd);
-        current_line = get_line_number(fd, lseek(fd, 0, SEEK_CUR));
+// Skips the thread's next line if it is a SHOW of the given event. Returns 1
+// if it was skipped, 0 otherwise.
+static int next_show(struct ThreadData *thread, unsigned int event_id) {
+    unsigned int next_id;
+    if (peek_next_command(thread) != CMD_SHOW ||
+        parse_show(thread->fd, &next_id) != 0 || next_id != event_id) {
+        return 0;
+    }
 
-        // Process the command based on its type
-        switch (cmd) {
-        case CMD_CREATE: {
-            unsigned int event_id;
-            size_t num_rows, num_cols;
-            if (parse_create(fd, &event_id, &num_rows, &num_cols) != 0) {
-                fprintf(stderr, "Invalid command. See HELP for usage\n");
-                continue;
-            }
-            if (current_line % max_thr == id - 1) {
-                if (ems_create(event_id, num_rows, num_cols)) {
-                    fprintf(stderr, "Failed to create event\n");
-                }
-            }
+    thread->next_line += (size_t)max_thr;
+    return 1;
+}
 
-            break;
+// Runs the command at the current offset of a .jobs file, the given line.
+// Returns 1 at a barrier, -1 at the end of the file, 0 otherwise.
+static int run_command(struct ThreadData *thread, int current_line) {
+    int fd = thread->fd, out_fd = thread->out_fd, id = thread->id;
+    enum Command cmd = get_next(fd);
+    uint64_t command_start = trace_now();
+
+    // Process the command based on its type
+    switch (cmd) {
+    case CMD_CREATE: {
+        unsigned int event_id;
+        size_t num_rows, num_cols;
+        if (parse_create(fd, &event_id, &num_rows, &num_cols) != 0) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
+        }
+        if (current_line % max_thr == id - 1) {
+            if (ems_create(event_id, num_rows, num_cols)) {
+                fprintf(stderr, "Failed to create event\n");
+            }
         }
-        case CMD_RESERVE: {
-            unsigned int event_id;
-            size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
 
-            size_t num_coords =
-                parse_reserve(fd, MAX_RESERVATION_SIZE, &event_id, xs, ys);
+        break;
+    }
+    case CMD_RESERVE: {
+        struct EventSeats batch[COMMAND_BATCH_MAX];
+        int results[COMMAND_BATCH_MAX];
+        size_t num_requests = 1;
+
+        if (parse_reserve(fd, &batch[0].event_id, &batch[0].xs, &batch[0].ys,
+                          &batch[0].num_seats, &batch[0].blocks,
+                          &batch[0].num_blocks) == 0) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
+        }
 
-            if (num_coords == 0) {
-                fprintf(stderr, "Invalid command. See HELP for usage\n");
-                continue;
+        if (current_line % max_thr == id - 1) {
+            // The RESERVEs of the same event on the next lines of this
+            // thread share one event lookup and lock. Under the virtual
+            // clock, each line waits for its turn instead
+            while (!vclock_enabled() && num_requests < COMMAND_BATCH_MAX &&
+                   next_reserve(thread, batch[0].event_id,
+                                &batch[num_requests])) {
+                num_requests++;
             }
 
-            if (current_line % max_thr == id - 1) {
-                if (ems_reserve(event_id, num_coords, xs, ys)) {
+            ems_reserve_batch(num_requests, batch, results);
+            for (size_t i = 0; i < num_requests; i++) {
+                if (results[i] != 0) {
                     fprintf(stderr, "Failed to reserve seats\n");
                 }
             }
-            break;
         }
-        case CMD_SHOW: {
+
+        for (size_t i = 0; i < num_requests; i++) {
+            free(batch[i].xs);
+            free(batch[i].ys);
+            free(batch[i].blocks);
+        }
+        break;
+    }
+    case CMD_RESERVE_MULTI: {
+        struct EventSeats *events;
+        size_t num_events = parse_reserve_multi(fd, &events);
+        if (num_events == 0) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
+        }
+
+        if (current_line % max_thr == id - 1) {
+            if (ems_reserve_multi(num_events, events)) {
+                fprintf(stderr, "Failed to reserve seats\n");
+            }
+        }
+
+        free_reserve_multi(events, num_events);
+        break;
+    }
+    case CMD_RESERVE_BEST: {
+        unsigned int event_id;
+        size_t num_seats;
+        if (parse_reserve_best(fd, &event_id, &num_seats) != 0) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
+        }
+        if (current_line % max_thr == id - 1) {
             // Lock the mutex for the file descriptor (out_fd)
-            pthread_mutex_lock(&output_file_lock);
-            unsigned int event_id;
-            if (parse_show(fd, &event_id) != 0) {
-                fprintf(stderr, "Invalid command. See HELP for usage\n");
-                continue;
+            lock_output_file();
+            if (ems_reserve_best(event_id, num_seats, out_fd)) {
+                fprintf(stderr, "Failed to reserve seats\n");
             }
-            if (current_line % max_thr == id - 1) {
-                if (ems_show(event_id, out_fd)) {
-                    fprintf(stderr, "Failed to show event\n");
-                }
+            pthread_mutex_unlock(&output_file_lock);
+        }
+        break;
+    }
+    case CMD_CANCEL: {
+        unsigned int event_id, reservation_id;
+        if (parse_cancel(fd, &event_id, &reservation_id) != 0) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
+        }
+        if (current_line % max_thr == id - 1) {
+            if (ems_cancel(event_id, reservation_id)) {
+                fprintf(stderr, "Failed to cancel reservation\n");
             }
+        }
+        break;
+    }
+    case CMD_SHOW: {
+        // Lock the mutex for the file descriptor (out_fd)
+        lock_output_file();
+        unsigned int event_id;
+        struct SeatBlock range;
+        if (parse_show_range(fd, &event_id, &range) != 0) {
             pthread_mutex_unlock(&output_file_lock);
-            break;
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
         }
-        case CMD_LIST_EVENTS: {
+        if (current_line % max_thr == id - 1 && range.row_from != 0) {
+            // Only the rectangle is locked and printed
+            if (ems_show_range(event_id, out_fd, &range)) {
+                fprintf(stderr, "Failed to show event\n");
+            }
+        } else if (current_line % max_thr == id - 1) {
+            // SHOWs of the same event on the next lines of this thread are
+            // printed from a single render, unless they must take turns
+            size_t count = 1;
+            while (!vclock_enabled() && count < COMMAND_BATCH_MAX &&
+                   next_show(thread, event_id)) {
+                count++;
+            }
+
+            if (ems_show_repeat(event_id, out_fd, count)) {
+                fprintf(stderr, "Failed to show event\n");
+            }
+        }
+        pthread_mutex_unlock(&output_file_lock);
+        break;
+    }
+    case CMD_SHOWDIFF: {
+        unsigned int event_id;
+        if (parse_show(fd, &event_id) != 0) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
+        }
+        if (current_line % max_thr == id - 1) {
             // Lock the mutex for the file descriptor (out_fd)
-            pthread_mutex_lock(&output_file_lock);
-            if (current_line % max_thr == id - 1) {
-                if (ems_list_events(out_fd)) {
-                    fprintf(stderr, "Failed to list events\n");
-                }
+            lock_output_file();
+            if (ems_show_diff(event_id, out_fd)) {
+                fprintf(stderr, "Failed to show event changes\n");
             }
             pthread_mutex_unlock(&output_file_lock);
-            break;
         }
-        case CMD_WAIT: {
-            // Initialize variables
-            unsigned int wait_delay;
-            unsigned int id_index;
-
+        break;
+    }
+    case CMD_STATS: {
+        unsigned int event_id;
+        if (parse_show(fd, &event_id) != 0) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
+        }
+        if (current_line % max_thr == id - 1) {
             // Lock the mutex for the file descriptor (out_fd)
-            pthread_mutex_lock(&output_file_lock);
-
-            // Parse the wait command
-            int wait_result = parse_wait(fd, &wait_delay, &id_index);
-            if (wait_result == -1) {
-                fprintf(stderr, "Invalid command. See HELP for usage\n");
-                continue;
+            lock_output_file();
+            if (ems_stats(event_id, out_fd)) {
+                fprintf(stderr, "Failed to show event statistics\n");
             }
-
             pthread_mutex_unlock(&output_file_lock);
+        }
+        break;
+    }
+    case CMD_LIST_EVENTS: {
+        // Lock the mutex for the file descriptor (out_fd)
+        lock_output_file();
+        if (current_line % max_thr == id - 1) {
+            if (ems_list_events(out_fd)) {
+                fprintf(stderr, "Failed to list events\n");
+            }
+        }
+        pthread_mutex_unlock(&output_file_lock);
+        break;
+    }
+    case CMD_WAIT: {
+        // Initialize variables
+        unsigned int wait_delay;
+        unsigned int id_index;
+
+        // Lock the mutex for the file descriptor (out_fd)
+        lock_output_file();
+
+        // Parse the wait command
+        int wait_result = parse_wait(fd, &wait_delay, &id_index);
+
+        pthread_mutex_unlock(&output_file_lock);
 
-            // Handle WAIT command
-            if (wait_result == 0) {
+        if (wait_result == -1) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+            return 0;
+        }
+
+        // Handle WAIT command
+        if (wait_result == 0) {
+            printf("Thread %d waiting...\n", id);
+            // All threads should wait
+            sched_wait(wait_delay);
+            trace_thread(id);
+            trace_span("WAIT", "wait", command_start);
+        } else if (wait_result == 1) {
+            // Only one thread should wait
+            if ((int)id_index == id) {
                 printf("Thread %d waiting...\n", id);
-                // All threads should wait
-                ems_wait(wait_delay);
-            } else if (wait_result == 1) {
-                // Only one thread should wait
-                if ((int)id_index == id) {
-                    printf("Thread %d waiting...\n", id);
-                    ems_wait(wait_delay);
-                }
+                sched_wait(wait_delay);
+                trace_thread(id);
+                trace_span("WAIT", "wait", command_start);
             }
-            break;
         }
-        case CMD_INVALID:
-            if (current_line % max_thr == id - 1) {
-                fprintf(stderr, "Invalid command. See HELP for usage\n");
-            }
-            break;
-        case CMD_HELP:
-            // Lock the mutex for the file descriptor (out_fd)
-            pthread_mutex_lock(&output_file_lock);
+        break;
+    }
+    case CMD_INVALID:
+        if (current_line % max_thr == id - 1) {
+            fprintf(stderr, "Invalid command. See HELP for usage\n");
+        }
+        break;
+    case CMD_HELP:
+        // Lock the mutex for the file descriptor (out_fd)
+        lock_output_file();
 
-            if (current_line % max_thr == id - 1) {
-                ems_help(out_fd);
-            }
+        if (current_line % max_thr == id - 1) {
+            ems_help(out_fd);
+        }
 
-            pthread_mutex_unlock(&output_file_lock);
-            break;
-        case CMD_BARRIER:
-            pthread_exit((void *)1);
-            break;
-        case CMD_EMPTY:
-            break;
-        case EOC:
-            eof_flag = 1;
+        pthread_mutex_unlock(&output_file_lock);
+        break;
+    case CMD_BARRIER:
+        return 1;
+    case CMD_EMPTY:
+        break;
+    case EOC:
+        return -1;
+    default:
+        break;
+    }
+
+    // Trace the commands this thread executed
+    if (current_line % max_thr == id - 1 && cmd != CMD_EMPTY &&
+        cmd != CMD_WAIT && cmd != EOC) {
+        trace_span(command_name(cmd), "command", command_start);
+    }
+    return 0;
+}
+
+// Parses the lines of a .jobs file this thread runs: its own lines, and the
+// lines every thread runs. Returns 1 if it stopped at a barrier.
+int parse_jobs_file(struct ThreadData *thread) {
+    const struct JobsIndex *index = thread->index;
+
+    while (1) {
+        // Go straight to the next line to run, in file order
+        size_t line = thread->next_line;
+        if (thread->next_global < index->num_global &&
+            index->global_lines[thread->next_global] <= line) {
+            line = index->global_lines[thread->next_global];
+        }
+        if (line >= index->num_lines) {
             break;
-        default:
+        }
+
+        if (line == thread->next_line) {
+            thread->next_line += (size_t)max_thr;
+        }
+        if (thread->next_global < index->num_global &&
+            index->global_lines[thread->next_global] == line) {
+            thread->next_global++;
+        }
+
+        // With the virtual clock, the threads take turns at every command
+        // in simulated time order
+        if (vclock_enabled()) {
+            sched_yield_worker();
+            trace_thread(thread->id);
+        }
+
+        io_seek(thread->fd, index->line_starts[line], SEEK_SET);
+        int result =
+            run_command(thread, (int)line + 1);
+        if (result == 1) {
+            return 1;
+        }
+        if (result == -1) {
             break;
         }
     }
 
     // Close the file
-    close(fd);
+    io_close(thread->fd);
+    thread->fd = -1;
     // Flush after processing each file
     fflush(stdout);
+    return 0;
 }
 
-// Parse the file using parse_jobs_file, and then exits the thread.
-void *process_file_thread(void *arg) {
-    // Allocate memory for thread-specific data
+// Parse the file using parse_jobs_file as a logical worker.
+int process_file_worker(void *arg) {
     struct ThreadData *thread_data = (struct ThreadData *)arg;
+    trace_thread(thread_data->id);
 
-    // Parse the .jobs file
-    parse_jobs_file(thread_data->fd, thread_data->out_fd, thread_data->id);
+    // Trace the time spent waiting for the other threads at a barrier
+    if (thread_data->barrier_start != 0) {
+        trace_span("BARRIER wait", "barrier", thread_data->barrier_start);
+        thread_data->barrier_start = 0;
+    }
 
-    // Exit the thread
-    pthread_exit(NULL);
+    // Parse the .jobs file
+    int result = parse_jobs_file(thread_data);
+    if (result == 1) {
+        thread_data->barrier_start = trace_now();
+    }
+    return result;
 }
 
-// Initialize threads to concurrently process the .jobs file
-void init_thread_list(pthread_t *threads, struct ThreadData *thread_list,
-                      const char *file_path, int out_fd) {
+// Initialize the logical workers that concurrently process the .jobs file
+void init_thread_list(struct ThreadData *thread_list, const char *file_path,
+                      int out_fd, const struct JobsIndex *index) {
     for (int i = 0; i < max_thr; ++i) {
 
         // Open the job file
         int fd = open(file_path, O_RDONLY);
         if (fd == -1) {
             perror("Error opening job file");
+        }
+
+        init_thread(&thread_list[i], i + 1, fd, out_fd, index);
+    }
+}
+
+// Initialize the data of one logical worker
+void init_thread(struct ThreadData *thread, int id, int fd, int out_fd,
+                 const struct JobsIndex *index) {
+    thread->id = id;
+    thread->fd = fd;
+    thread->out_fd = out_fd;
+    thread->barrier_start = 0;
+
+    // Thread id runs the lines whose number is id - 1 modulo max_thr
+    thread->index = index;
+    thread->next_line = (size_t)((id - 2 + max_thr) % max_thr);
+    thread->next_global = 0;
+}
+
+// Run the logical workers until they are past every barrier
+int process_jobs(struct ThreadData *thread_list) {
+    void **args = malloc((size_t)max_thr * sizeof(void *));
+    int *results = malloc((size_t)max_thr * sizeof(int));
+    if (args == NULL || results == NULL) {
+        fprintf(stderr, "Error allocating memory for workers\n");
+        free(args);
+        free(results);
+        return 1;
+    }
+
+    for (int i = 0; i < max_thr; ++i) {
+        args[i] = &thread_list[i];
+    }
+
+    // Barrier synchronization loop
+    int result = 0;
+    while (1) {
+        if (sched_run((size_t)max_thr, (size_t)max_carriers,
+                      process_file_worker, args, results) != 0) {
+            result = 1;
+            break;
+        }
+
+        int barrier = 0;
+        for (int i = 0; i < max_thr; ++i) {
+            if (results[i] == 1) {
+                barrier = 1; // Set the barrier flag when a worker
+                             // reaches the barrier
+            }
+        }
+        if (!barrier) {
+            break; // Exit the when no barrier is reached
+        }
+        vclock_barrier();
+        // Run the workers again to continue processing
+    }
+
+    free(args);
+    free(results);
+    return result;
+}
+
+/// Frees a list of file names.
+static void free_names(char **names, size_t num_names) {
+    for (size_t i = 0; i < num_names; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+/// Lists the .jobs files of a directory, in directory order.
+/// @param dir Directory to list.
+/// @param num_files Set to the number of files found.
+/// @return Array of file names, NULL on failure.
+static char **list_jobs_files(DIR *dir, size_t *num_files) {
+    size_t count = 0, cap = 16;
+    char **names = malloc(cap * sizeof(char *));
+    if (names == NULL) {
+        fprintf(stderr, "Error allocating memory for file list\n");
+        return NULL;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        // Check if the file has a ".jobs" extension
+        if (!endsWith(entry->d_name, ".jobs")) {
             continue;
         }
 
-        // Initialize thread data
-        thread_list[i].id = i + 1;
-        thread_list[i].fd = fd;
-        thread_list[i].out_fd = out_fd;
+        if (count == cap) {
+            cap *= 2;
+            char **grown = realloc(names, cap * sizeof(char *));
+            if (grown == NULL) {
+                fprintf(stderr, "Error allocating memory for file list\n");
+                free_names(names, count);
+                return NULL;
+            }
+            names = grown;
+        }
 
-        // Create threads to process the file
-        if (pthread_create(&threads[i], NULL, process_file_thread,
-                           (void *)&thread_list[i]) != 0) {
-            perror("Error creating thread");
-            return;
+        names[count] = strdup(entry->d_name);
+        if (names[count] == NULL) {
+            fprintf(stderr, "Error allocating memory for file list\n");
+            free_names(names, count);
+            return NULL;
         }
+        count++;
     }
+
+    *num_files = count;
+    return names;
+}
+
+/// Asks the kernel to start reading a .jobs file into the page cache, so
+/// that the child process that indexes it does not wait for the disk.
+/// @param dir_path Directory of the file.
+/// @param name Name of the file.
+static void prefetch_jobs_file(const char *dir_path, const char *name) {
+    char file_path[PATH_MAX];
+    snprintf(file_path, sizeof(file_path), "%s/%s", dir_path, name);
+
+    int fd = open(file_path, O_RDONLY);
+    if (fd == -1) {
+        return; // The child reports the error when it opens the file
+    }
+
+    // The read-ahead is asynchronous and outlives the descriptor
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
 }
 
 // Function to process all files in a directory
@@ -254,111 +659,137 @@ void process_directory(char argv[]) {
         return;
     }
 
-    struct dirent *entry;
+    // List the .jobs files first, so the next ones can be read ahead
+    size_t num_files = 0;
+    char **names = list_jobs_files(dir, &num_files);
+    if (names == NULL) {
+        closedir(dir);
+        return;
+    }
+
     int active_processes = 0;
+    size_t prefetched = 0;
 
     // For each file found in the directory
-    while ((entry = readdir(dir)) != NULL) {
-        // Check if the file has a ".jobs" extension
-        if (endsWith(entry->d_name, ".jobs")) {
+    for (size_t file = 0; file < num_files; file++) {
+        // Start reading the next files from disk while this one is processed
+        while (prefetched < num_files && prefetched <= file + READAHEAD_FILES) {
+            prefetch_jobs_file(argv, names[prefetched++]);
+        }
 
-            // Reset the event list before processing each file
-            reset_event_list();
+        // Reset the event list before processing each file
+        reset_event_list();
 
-            // Construct the path to the job file
-            char file_path[PATH_MAX];
-            snprintf(file_path, sizeof(file_path), "%s/%s", argv,
-                     entry->d_name);
+        // Construct the path to the job file
+        char file_path[PATH_MAX];
+        snprintf(file_path, sizeof(file_path), "%s/%s", argv, names[file]);
 
-            // Construct the file name
-            char base_name[PATH_MAX];
-            snprintf(base_name, sizeof(base_name), "%.*s",
-                     (int)(strrchr(entry->d_name, '.') - entry->d_name),
-                     entry->d_name);
+        // Construct the file name
+        char base_name[PATH_MAX];
+        snprintf(base_name, sizeof(base_name), "%.*s",
+                 (int)(strrchr(names[file], '.') - names[file]), names[file]);
 
-            pid_t pid = fork();
+        pid_t pid = fork();
 
-            if (pid == 0) { // Child process
-                printf("Child process [%d] started\n", getpid());
+        if (pid == 0) { // Child process
+            printf("Child process [%d] started\n", getpid());
+            affinity_pin_process();
 
-                // Open the output file for writing
-                int out_fd = open_output_file(base_name, argv);
-                if (out_fd == -1) {
-                    perror("Error opening output file");
-                    return;
-                }
+            // Open the output file for writing
+            int out_fd = open_output_file(base_name, argv);
+            if (out_fd == -1) {
+                perror("Error opening output file");
+                exit(1);
+            }
 
-                // Array to store each thread
-                pthread_t threads[max_thr];
-
-                // Create a list of threads structures
-                struct ThreadData *thread_list = malloc(
-                    (long unsigned int)max_thr * sizeof(struct ThreadData));
-
-                // Create thread data and populate it
-                init_thread_list(threads, thread_list, file_path, out_fd);
-
-                void *value = 0;
-                int barrier = 0;
-
-                // Barrier synchronization loop
-                while (1) {
-                    for (int i = 0; i < max_thr; ++i) {
-                        pthread_join(threads[i], &value);
-                        if (value == (void *)1) {
-                            barrier = 1; // Set the barrier flag when a thread
-                                         // reaches the barrier
-                        }
-                    }
-                    if (barrier) {
-                        barrier = 0;
-                        // Create a new set of threads to continue processing
-                        for (int i = 0; i < max_thr; ++i) {
-                            if (pthread_create(&threads[i], NULL,
-                                               process_file_thread,
-                                               (void *)&thread_list[i]) != 0) {
-                                return;
-                            }
-                        }
-                    } else {
-                        break; // Exit the when no barrier is reached
-                    }
-                }
-                // Close the output file descriptor
+            // Recover the state logged by a previous run and keep
+            // logging this one
+            if (wal_enabled()) {
+                open_log_file(base_name, argv);
+            }
+
+            // Find where every line starts, so each thread only reads
+            // its own lines
+            struct JobsIndex index;
+            if (jobs_index_build(file_path, (size_t)max_carriers,
+                                 &index) != 0) {
                 close(out_fd);
+                exit(1);
+            }
 
-                // Free allocated memory for thread's data
-                free(thread_list);
+            // Create a list of threads structures
+            struct ThreadData *thread_list =
+                malloc((long unsigned int)max_thr * sizeof(struct ThreadData));
+
+            // Create thread data and populate it
+            init_thread_list(thread_list, file_path, out_fd, &index);
+            trace_open(max_thr);
+            vclock_open(max_thr);
+
+            // Run the workers, stopping at every barrier
+            process_jobs(thread_list);
+            // Commit the remaining log records
+            wal_close();
+
+            // Report the memory the events of this file used
+            printf("Child process [%d] used %zu bytes for events, peak "
+                   "%zu\n",
+                   getpid(), memory_current(), memory_peak());
+
+            // Report the simulated time this file took
+            if (vclock_enabled()) {
+                printf("Child process [%d] simulated %.3f s in %.3f s of CPU "
+                       "time\n",
+                       getpid(), (double)vclock_elapsed() / 1e9,
+                       (double)vclock_cpu_time() / 1e9);
+                vclock_close();
+            }
+
+            // Dump the timeline of this file
+            if (trace_enabled()) {
+                write_trace_file(base_name, argv);
+            }
+
+            // Dump the hot rows and seats of this file
+            if (contention_top() > 0) {
+                write_contention_file(base_name, argv);
+            }
 
-                // Wait for child processes to finish
+            // Close the output file descriptor
+            close(out_fd);
+
+            // Free allocated memory for thread's data
+            free(thread_list);
+            jobs_index_free(&index);
+
+            // Wait for child processes to finish
+            int status;
+            wait(&status);
+            printf("Child process [%d] exited with status[%d]\n", getpid(),
+                   WEXITSTATUS(status));
+                   
+            // Exit the child process
+            exit(0);
+        } else if (pid > 0) {
+            // Parent process
+            active_processes++;
+            printf("Parent process [%d] created child process [%d]\n",
+                   getpid(), pid);
+
+            // Wait for child processes to avoid exceeding the maximum
+            // allowed
+            while (active_processes >= max_proc) {
                 int status;
-                wait(&status);
-                printf("Child process [%d] exited with status[%d]\n", getpid(),
-                       WEXITSTATUS(status));
-                       
-                // Exit the child process
-                exit(0);
-            } else if (pid > 0) {
-                // Parent process
-                active_processes++;
-                printf("Parent process [%d] created child process [%d]\n",
-                       getpid(), pid);
-
-                // Wait for child processes to avoid exceeding the maximum
-                // allowed
-                while (active_processes >= max_proc) {
-                    int status;
-                    pid_t child_pid = wait(&status);
-                    if (child_pid > 0) {
-                        active_processes--;
-                        printf("Parent process [%d] waited for child process "
-                               "[%d]\n",
-                               getpid(), child_pid);
-                    }
+                pid_t child_pid = wait(&status);
+                if (child_pid > 0) {
+                    active_processes--;
+                    printf("Parent process [%d] waited for child process "
+                           "[%d]\n",
+                           getpid(), child_pid);
                 }
-            } else {
-                perror("Fork failed");
             }
+        } else {
+            perror("Fork failed");
         }
     }
 
@@ -372,5 +803,6 @@ void process_directory(char argv[]) {
     }
 
     // Close the jobs directory
+    free_names(names, num_files);
     closedir(dir);
 }
\ No newline at end of file
@@ -3,27 +3,39 @@
 #define PARALLELIZATION_H
 
 #include "constants.h"
+#include "jobsindex.h"
 #include <pthread.h>
 #include <fcntl.h>
+#include <stdint.h>
 
 extern int max_thr;
 extern int max_proc;
+extern int max_carriers;
 
 // Structure to hold thread-specific data
 struct ThreadData {
     int id;     // Thread ID
     int fd;     // File descriptor
     int out_fd; // Output file descriptor
+    uint64_t barrier_start; // Trace time the thread reached a barrier
+    const struct JobsIndex *index; // Lines of the .jobs file
+    size_t next_line;   // Next line of the thread, from 0
+    size_t next_global; // Next global line of the index to run
 };
 
 // Declare functions from parser.c
 int endsWith(const char *str, const char *suffix);
-int get_line_number(int fd, off_t offset);
 int open_output_file(const char *base_name, char argv[]);
-void parse_jobs_file(int fd, int out_fd, int id);
-void *process_file_thread(void *arg);
-void init_thread_list(pthread_t *threads, struct ThreadData *thread_list,
-                      const char *file_path, int out_fd);
+int open_log_file(const char *base_name, char argv[]);
+int write_trace_file(const char *base_name, char argv[]);
+int write_contention_file(const char *base_name, char argv[]);
+int parse_jobs_file(struct ThreadData *thread);
+int process_file_worker(void *arg);
+void init_thread_list(struct ThreadData *thread_list, const char *file_path,
+                      int out_fd, const struct JobsIndex *index);
+void init_thread(struct ThreadData *thread, int id, int fd, int out_fd,
+                 const struct JobsIndex *index);
+int process_jobs(struct ThreadData *thread_list);
 void process_directory(char argv[]);
 
 #endif // PARALLELIZATION_H
@@ -1,18 +1,23 @@
 #include "parser.h"
+#include "memio.h"
 
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-#include "constants.h"
+#if defined(__SSE2__) && !defined(EMS_NO_SIMD)
+#include <emmintrin.h>
+#endif
+
 
 static int read_uint(int fd, unsigned int *value, char *next) {
     char buf[16];
 
     int i = 0;
     while (1) {
-        if (read(fd, buf + i, 1) == 0) {
+        if (io_read(fd, buf + i, 1) == 0) {
             *next = '\0';
             break;
         }
@@ -40,48 +45,99 @@ static int read_uint(int fd, unsigned int *value, char *next) {
 
 static void cleanup(int fd) {
     char ch;
-    while (read(fd, &ch, 1) == 1 && ch != '\n')
+    while (io_read(fd, &ch, 1) == 1 && ch != '\n')
         ;
 }
 
 enum Command get_next(int fd) {
     char buf[16];
-    if (read(fd, buf, 1) != 1) {
+    if (io_read(fd, buf, 1) != 1) {
         return EOC;
     }
 
     switch (buf[0]) {
     case 'C':
-        if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "CREATE ", 7) != 0) {
+        if (io_read(fd, buf + 1, 6) != 6) {
             cleanup(fd);
             return CMD_INVALID;
         }
 
-        return CMD_CREATE;
+        if (strncmp(buf, "CREATE ", 7) == 0) {
+            return CMD_CREATE;
+        }
+
+        if (strncmp(buf, "CANCEL ", 7) == 0) {
+            return CMD_CANCEL;
+        }
+
+        cleanup(fd);
+        return CMD_INVALID;
 
     case 'R':
-        if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE ", 8) != 0) {
+        if (io_read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE", 7) != 0) {
             cleanup(fd);
             return CMD_INVALID;
         }
 
-        return CMD_RESERVE;
+        if (buf[7] == ' ') {
+            return CMD_RESERVE;
+        }
+
+        if (io_read(fd, buf + 8, 5) != 5) {
+            cleanup(fd);
+            return CMD_INVALID;
+        }
+
+        if (strncmp(buf, "RESERVE_BEST ", 13) == 0) {
+            return CMD_RESERVE_BEST;
+        }
+
+        if (strncmp(buf, "RESERVE_MULTI", 13) != 0 ||
+            io_read(fd, buf + 13, 1) != 1 || buf[13] != ' ') {
+            cleanup(fd);
+            return CMD_INVALID;
+        }
+
+        return CMD_RESERVE_MULTI;
 
     case 'S':
-        if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
+        if (io_read(fd, buf + 1, 4) != 4) {
+            cleanup(fd);
+            return CMD_INVALID;
+        }
+
+        if (strncmp(buf, "STATS", 5) == 0) {
+            if (io_read(fd, buf + 5, 1) != 1 || buf[5] != ' ') {
+                cleanup(fd);
+                return CMD_INVALID;
+            }
+
+            return CMD_STATS;
+        }
+
+        if (strncmp(buf, "SHOW", 4) != 0) {
+            cleanup(fd);
+            return CMD_INVALID;
+        }
+
+        if (buf[4] == ' ') {
+            return CMD_SHOW;
+        }
+
+        if (io_read(fd, buf + 5, 4) != 4 || strncmp(buf, "SHOWDIFF ", 9) != 0) {
             cleanup(fd);
             return CMD_INVALID;
         }
 
-        return CMD_SHOW;
+        return CMD_SHOWDIFF;
 
     case 'L':
-        if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
+        if (io_read(fd, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
             cleanup(fd);
             return CMD_INVALID;
         }
 
-        if (read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
+        if (io_read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
             cleanup(fd);
             return CMD_INVALID;
         }
@@ -89,12 +145,12 @@ enum Command get_next(int fd) {
         return CMD_LIST_EVENTS;
 
     case 'B':
-        if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "BARRIER", 7) != 0) {
+        if (io_read(fd, buf + 1, 6) != 6 || strncmp(buf, "BARRIER", 7) != 0) {
             cleanup(fd);
             return CMD_INVALID;
         }
 
-        if (read(fd, buf + 7, 1) != 0 && buf[7] != '\n') {
+        if (io_read(fd, buf + 7, 1) != 0 && buf[7] != '\n') {
             cleanup(fd);
             return CMD_INVALID;
         }
@@ -102,7 +158,7 @@ enum Command get_next(int fd) {
         return CMD_BARRIER;
 
     case 'W':
-        if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "WAIT ", 5) != 0) {
+        if (io_read(fd, buf + 1, 4) != 4 || strncmp(buf, "WAIT ", 5) != 0) {
             cleanup(fd);
             return CMD_INVALID;
         }
@@ -110,12 +166,12 @@ enum Command get_next(int fd) {
         return CMD_WAIT;
 
     case 'H':
-        if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "HELP", 4) != 0) {
+        if (io_read(fd, buf + 1, 3) != 3 || strncmp(buf, "HELP", 4) != 0) {
             cleanup(fd);
             return CMD_INVALID;
         }
 
-        if (read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
+        if (io_read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
             cleanup(fd);
             return CMD_INVALID;
         }
@@ -161,64 +217,368 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows,
     return 0;
 }
 
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs,
-                     size_t *ys) {
+// Append a seat to the growable coordinate arrays.
+static int push_seat(size_t **xs, size_t **ys, size_t *cap, size_t len,
+                     size_t x, size_t y) {
+    if (len == *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 16;
+        size_t *new_xs = realloc(*xs, new_cap * sizeof(size_t));
+        if (new_xs == NULL) {
+            return 1;
+        }
+        *xs = new_xs;
+
+        size_t *new_ys = realloc(*ys, new_cap * sizeof(size_t));
+        if (new_ys == NULL) {
+            return 1;
+        }
+        *ys = new_ys;
+        *cap = new_cap;
+    }
+
+    (*xs)[len] = x;
+    (*ys)[len] = y;
+    return 0;
+}
+
+// Bytes past the end of a line buffer that vector loads may touch
+#define LINE_PADDING 16
+
+/// Rest of a command line, read into memory so it can be tokenized without a
+/// system call per character.
+struct Line {
+    char *data;      // Line, its newline if any, then zeroed padding.
+    const char *pos; // Next character to tokenize.
+    const char *end; // End of the line, including its newline.
+};
+
+// Read the rest of the current line, leaving fd right after its newline.
+static int read_line(int fd, struct Line *line) {
+    size_t len = 0, cap = 0;
+    char *data = NULL;
+
+    while (1) {
+        if (cap - len < 4096 + LINE_PADDING) {
+            cap = cap ? cap * 2 : 4096 + LINE_PADDING;
+            char *new_data = realloc(data, cap);
+            if (new_data == NULL) {
+                free(data);
+                return 1;
+            }
+            data = new_data;
+        }
+
+        ssize_t result = io_read(fd, data + len, cap - len - LINE_PADDING);
+        if (result <= 0) {
+            break;
+        }
+
+        // Give back what was read past the newline
+        char *newline = memchr(data + len, '\n', (size_t)result);
+        if (newline != NULL) {
+            io_seek(fd, -(off_t)(data + len + result - newline - 1), SEEK_CUR);
+            len = (size_t)(newline - data) + 1;
+            break;
+        }
+        len += (size_t)result;
+    }
+
+    memset(data + len, 0, LINE_PADDING);
+    line->data = data;
+    line->pos = data;
+    line->end = data + len;
+    return 0;
+}
+
+// Get the next character of a line, '\0' at its end.
+static char next_char(struct Line *line) {
+    return line->pos < line->end ? *line->pos++ : '\0';
+}
+
+// Check that the character after the last token of a line was a newline or
+// a NUL character, and not the end of a file missing its last newline.
+static int ends_line(const struct Line *line, char ch) {
+    return ch == '\n' || (ch == '\0' && line->pos > line->data &&
+                          line->pos[-1] == '\0');
+}
+
+#if defined(__SSE2__) && !defined(EMS_NO_SIMD)
+// Count the digits at the start of a padded buffer, 16 characters at a time.
+static size_t count_digits(const char *str) {
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+
+    for (size_t n = 0;; n += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(str + n));
+
+        // Digits become 0 to 9, anything else wraps above 9
+        __m128i value = _mm_sub_epi8(chunk, zero);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(value, nine), value);
+
+        unsigned int others = ~(unsigned int)_mm_movemask_epi8(is_digit) & 0xffff;
+        if (others != 0) {
+            return n + (size_t)__builtin_ctz(others);
+        }
+    }
+}
+#else
+// Count the digits at the start of a buffer.
+static size_t count_digits(const char *str) {
+    size_t n = 0;
+    while (str[n] >= '0' && str[n] <= '9') {
+        n++;
+    }
+    return n;
+}
+#endif
+
+// Convert a run of digits to a number, saturating at UINT64_MAX.
+static uint64_t convert_digits(const char *str, size_t n) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (n > 0 && n <= 8) {
+        // Convert all eight digits at once: the characters past the run are
+        // shifted out, leaving leading zeros
+        uint64_t value;
+        memcpy(&value, str, 8);
+        value -= 0x3030303030303030;
+        value <<= (8 - n) * 8;
+
+        // Combine adjacent digits, then pairs, then quadruples
+        value = value * 10 + (value >> 8);
+        return ((value & 0x000000ff000000ff) * (100 + (1000000ULL << 32)) +
+                ((value >> 16) & 0x000000ff000000ff) *
+                    (1 + (10000ULL << 32))) >>
+               32;
+    }
+#endif
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (value > (UINT64_MAX - 9) / 10) {
+            return UINT64_MAX;
+        }
+        value = value * 10 + (uint64_t)(str[i] - '0');
+    }
+    return value;
+}
+
+// Tokenize a number and the character after it, like read_uint.
+static int scan_uint(struct Line *line, unsigned int *value, char *next) {
+    size_t n = count_digits(line->pos);
+    if (line->pos + n > line->end) {
+        n = (size_t)(line->end - line->pos);
+    }
+
+    uint64_t number = convert_digits(line->pos, n);
+    line->pos += n;
+    *next = next_char(line);
+
+    if (number > UINT_MAX) {
+        return 1;
+    }
+
+    *value = (unsigned int)number;
+    return 0;
+}
+
+// Tokenize a "(x,y)" coordinate, after its opening parenthesis.
+static int scan_coord(struct Line *line, unsigned int *x, unsigned int *y) {
     char ch;
 
-    if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
-        cleanup(fd);
-        return 0;
+    if (scan_uint(line, x, &ch) != 0 || ch != ',') {
+        return 1;
     }
 
-    if (read(fd, &ch, 1) != 1 || ch != '[') {
-        cleanup(fd);
-        return 0;
+    if (scan_uint(line, y, &ch) != 0 || ch != ')') {
+        return 1;
     }
 
-    size_t num_coords = 0;
-    while (num_coords < max) {
-        if (read(fd, &ch, 1) != 1 || ch != '(') {
-            cleanup(fd);
-            return 0;
+    return 0;
+}
+
+// Tokenize a "[...]" list of seats and blocks of seats, and the character
+// after it. The arrays are left allocated on failure.
+static int scan_seats(struct Line *line, struct EventSeats *seats,
+                      char *next) {
+    if (next_char(line) != '[') {
+        return 1;
+    }
+
+    size_t seats_cap = 0, blocks_cap = 0;
+    while (1) {
+        unsigned int x, y;
+        char ch;
+        if (next_char(line) != '(' || scan_coord(line, &x, &y) != 0) {
+            return 1;
+        }
+        ch = next_char(line);
+
+        if (ch == '-') {
+            // Block from (x,y) to the next coordinate
+            unsigned int x_to, y_to;
+            if (next_char(line) != '(' || scan_coord(line, &x_to, &y_to) != 0) {
+                return 1;
+            }
+            ch = next_char(line);
+
+            if (seats->num_blocks == blocks_cap) {
+                blocks_cap = blocks_cap ? blocks_cap * 2 : 4;
+                struct SeatBlock *new_blocks = realloc(
+                    seats->blocks, blocks_cap * sizeof(struct SeatBlock));
+                if (new_blocks == NULL) {
+                    return 1;
+                }
+                seats->blocks = new_blocks;
+            }
+
+            // Corners may be given in any order
+            seats->blocks[seats->num_blocks++] = (struct SeatBlock){
+                x < x_to ? x : x_to, y < y_to ? y : y_to,
+                x < x_to ? x_to : x, y < y_to ? y_to : y};
+        } else {
+            if (push_seat(&seats->xs, &seats->ys, &seats_cap, seats->num_seats,
+                          x, y) != 0) {
+                return 1;
+            }
+            seats->num_seats++;
         }
 
-        unsigned int x;
-        if (read_uint(fd, &x, &ch) != 0 || ch != ',') {
-            cleanup(fd);
+        if (ch == ']') {
+            *next = next_char(line);
             return 0;
         }
-        xs[num_coords] = (size_t)x;
 
-        unsigned int y;
-        if (read_uint(fd, &y, &ch) != 0 || ch != ')') {
-            cleanup(fd);
-            return 0;
+        if (ch != ' ') {
+            return 1;
         }
-        ys[num_coords] = (size_t)y;
+    }
+}
+
+size_t parse_reserve(int fd, unsigned int *event_id, size_t **xs, size_t **ys,
+                     size_t *num_seats, struct SeatBlock **blocks,
+                     size_t *num_blocks) {
+    struct Line line;
+    struct EventSeats seats = {0, 0, NULL, NULL, 0, NULL};
+    char ch;
 
-        num_coords++;
+    *xs = NULL;
+    *ys = NULL;
+    *blocks = NULL;
+    *num_seats = 0;
+    *num_blocks = 0;
 
-        if (read(fd, &ch, 1) != 1 || (ch != ' ' && ch != ']')) {
-            cleanup(fd);
-            return 0;
+    if (read_line(fd, &line) != 0) {
+        cleanup(fd);
+        return 0;
+    }
+
+    if (scan_uint(&line, event_id, &ch) == 0 && ch == ' ' &&
+        scan_seats(&line, &seats, &ch) == 0 && ends_line(&line, ch)) {
+        free(line.data);
+        *xs = seats.xs;
+        *ys = seats.ys;
+        *blocks = seats.blocks;
+        *num_seats = seats.num_seats;
+        *num_blocks = seats.num_blocks;
+        return *num_seats + *num_blocks;
+    }
+
+    free(line.data);
+    free(seats.xs);
+    free(seats.ys);
+    free(seats.blocks);
+    return 0;
+}
+
+size_t parse_reserve_multi(int fd, struct EventSeats **events) {
+    struct Line line;
+    char ch = ' ';
+    size_t num_events = 0, events_cap = 0;
+    int failed = 0;
+    *events = NULL;
+
+    if (read_line(fd, &line) != 0) {
+        cleanup(fd);
+        return 0;
+    }
+
+    // Tokenize "<event_id> [...]" groups until the end of the line
+    while (ch == ' ') {
+        if (num_events == events_cap) {
+            events_cap = events_cap ? events_cap * 2 : 4;
+            struct EventSeats *new_events =
+                realloc(*events, events_cap * sizeof(struct EventSeats));
+            if (new_events == NULL) {
+                failed = 1;
+                break;
+            }
+            *events = new_events;
         }
 
-        if (ch == ']') {
+        struct EventSeats *seats = &(*events)[num_events++];
+        *seats = (struct EventSeats){0, 0, NULL, NULL, 0, NULL};
+
+        if (scan_uint(&line, &seats->event_id, &ch) != 0 || ch != ' ' ||
+            scan_seats(&line, seats, &ch) != 0) {
+            failed = 1;
             break;
         }
     }
 
-    if (num_coords == max) {
+    int ended = !failed && ends_line(&line, ch);
+    free(line.data);
+    if (ended) {
+        return num_events;
+    }
+
+    free_reserve_multi(*events, num_events);
+    *events = NULL;
+    return 0;
+}
+
+void free_reserve_multi(struct EventSeats *events, size_t num_events) {
+    for (size_t i = 0; i < num_events; i++) {
+        free(events[i].xs);
+        free(events[i].ys);
+        free(events[i].blocks);
+    }
+    free(events);
+}
+
+int parse_cancel(int fd, unsigned int *event_id,
+                 unsigned int *reservation_id) {
+    char ch;
+
+    if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
         cleanup(fd);
-        return 0;
+        return 1;
     }
 
-    if (read(fd, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
+    if (read_uint(fd, reservation_id, &ch) != 0 ||
+        (ch != '\n' && ch != '\0')) {
         cleanup(fd);
-        return 0;
+        return 1;
     }
 
-    return num_coords;
+    return 0;
+}
+
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats) {
+    char ch;
+
+    if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+        cleanup(fd);
+        return 1;
+    }
+
+    unsigned int u_num_seats;
+    if (read_uint(fd, &u_num_seats, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+        cleanup(fd);
+        return 1;
+    }
+    *num_seats = (size_t)u_num_seats;
+
+    return 0;
 }
 
 int parse_show(int fd, unsigned int *event_id) {
@@ -231,6 +591,52 @@ int parse_show(int fd, unsigned int *event_id) {
 
     return 0;
 }
+/// Parses a range "<from>-<to>" of rows or columns, which start at 1.
+/// @param next Set to the character after the range.
+/// @return 0 if the range was parsed successfully, 1 otherwise.
+static int read_range(int fd, size_t *from, size_t *to, char *next) {
+    unsigned int u_from, u_to;
+    char ch;
+
+    if (read_uint(fd, &u_from, &ch) != 0 || ch != '-' || u_from == 0 ||
+        read_uint(fd, &u_to, next) != 0) {
+        return 1;
+    }
+
+    *from = (size_t)u_from;
+    *to = (size_t)u_to;
+    return 0;
+}
+
+int parse_show_range(int fd, unsigned int *event_id, struct SeatBlock *range) {
+    char ch;
+    *range = (struct SeatBlock){0, 0, 0, 0};
+
+    if (read_uint(fd, event_id, &ch) != 0) {
+        cleanup(fd);
+        return 1;
+    }
+
+    // Rows, then columns
+    if (ch == ' ' &&
+        read_range(fd, &range->row_from, &range->row_to, &ch) != 0) {
+        cleanup(fd);
+        return 1;
+    }
+    if (ch == ' ' &&
+        read_range(fd, &range->col_from, &range->col_to, &ch) != 0) {
+        cleanup(fd);
+        return 1;
+    }
+
+    if (ch != '\n' && ch != '\0') {
+        cleanup(fd);
+        return 1;
+    }
+
+    return 0;
+}
+
 int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
     char ch;
 
@@ -1,12 +1,18 @@
 #ifndef EMS_PARSER_H
 #define EMS_PARSER_H
 
+#include "operations.h"
 #include <stddef.h>
 
 enum Command {
   CMD_CREATE,
   CMD_RESERVE,
+  CMD_RESERVE_BEST,
+  CMD_RESERVE_MULTI,
+  CMD_CANCEL,
   CMD_SHOW,
+  CMD_SHOWDIFF,
+  CMD_STATS,
   CMD_LIST_EVENTS,
   CMD_BARRIER,
   CMD_WAIT,
@@ -30,21 +36,65 @@ enum Command get_next(int fd);
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
 
-/// Parses a RESERVE command.
+/// Parses a RESERVE command, made of single seats "(x,y)" and blocks of seats
+/// "(x1,y1)-(x2,y2)". The coordinate arrays grow as the command is read and
+/// must be freed by the caller.
 /// @param fd File descriptor to read from.
-/// @param max Maximum number of coordinates to read.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @param xs Pointer to the array to store the X coordinates in.
 /// @param ys Pointer to the array to store the Y coordinates in.
-/// @return Number of coordinates read. 0 on failure.
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
+/// @param num_seats Pointer to the variable to store the number of seats in.
+/// @param blocks Pointer to the array to store the blocks in.
+/// @param num_blocks Pointer to the variable to store the number of blocks in.
+/// @return Number of seats and blocks read. 0 on failure.
+size_t parse_reserve(int fd, unsigned int *event_id, size_t **xs, size_t **ys,
+                     size_t *num_seats, struct SeatBlock **blocks,
+                     size_t *num_blocks);
 
-/// Parses a SHOW command.
+/// Parses a RESERVE_MULTI command: one or more "<event_id> [...]" groups, each
+/// with the seats and blocks of seats RESERVE accepts.
+/// @param fd File descriptor to read from.
+/// @param events Pointer to the array to store the seats of each event in. It
+/// must be freed by the caller with free_reserve_multi().
+/// @return Number of events read. 0 on failure.
+size_t parse_reserve_multi(int fd, struct EventSeats **events);
+
+/// Frees the seats read by parse_reserve_multi().
+/// @param events Array of seats of each event.
+/// @param num_events Number of events.
+void free_reserve_multi(struct EventSeats *events, size_t num_events);
+
+/// Parses a CANCEL command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param reservation_id Pointer to the variable to store the reservation ID
+/// in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_cancel(int fd, unsigned int *event_id,
+                 unsigned int *reservation_id);
+
+/// Parses a RESERVE_BEST command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param num_seats Pointer to the variable to store the number of seats in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats);
+
+/// Parses a SHOW, SHOWDIFF or STATS command.
 /// @param fd File descriptor to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_show(int fd, unsigned int *event_id);
 
+/// Parses a SHOW command, with an optional range of rows and of columns:
+/// "<event_id> [<row_from>-<row_to> [<col_from>-<col_to>]]".
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param range Pointer to the block to store the range in. Its row_from is
+/// 0 without a range, and its col_from is 0 without a range of columns.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_show_range(int fd, unsigned int *event_id, struct SeatBlock *range);
+
 /// Parses a WAIT command.
 /// @param fd File descriptor to read from.
 /// @param delay Pointer to the variable to store the wait delay in.
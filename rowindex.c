@@ -0,0 +1,115 @@
+#include "rowindex.h"
+
+#include <stdlib.h>
+
+// Combine the runs of two adjacent ranges of `len` seats each.
+static struct FreeRun combine(struct FreeRun left, struct FreeRun right,
+                              size_t len) {
+    struct FreeRun run;
+
+    run.prefix = left.prefix == len ? len + right.prefix : left.prefix;
+    run.suffix = right.suffix == len ? len + left.suffix : right.suffix;
+
+    run.best = left.best > right.best ? left.best : right.best;
+    if (left.suffix + right.prefix > run.best) {
+        run.best = left.suffix + right.prefix;
+    }
+
+    return run;
+}
+
+// Get the smallest power of two that has a leaf for every seat
+static size_t count_leaves(size_t cols) {
+    size_t leaves = 1;
+    while (leaves < cols) {
+        leaves *= 2;
+    }
+    return leaves;
+}
+
+size_t row_index_size(size_t cols) {
+    return sizeof(struct RowIndex) +
+           2 * count_leaves(cols) * sizeof(struct FreeRun);
+}
+
+struct RowIndex *row_index_create(size_t cols) {
+    size_t leaves = count_leaves(cols);
+
+    struct RowIndex *index = malloc(row_index_size(cols));
+    if (!index)
+        return NULL;
+
+    pthread_mutex_init(&index->lock, NULL);
+    index->cols = cols;
+    index->leaves = leaves;
+
+    // Padding leaves are taken, so no run crosses the end of the row
+    for (size_t i = 0; i < leaves; i++) {
+        size_t free_seats = i < cols ? 1 : 0;
+        index->nodes[leaves + i] =
+            (struct FreeRun){free_seats, free_seats, free_seats};
+    }
+
+    // Build the levels bottom up; children of a level cover `len` seats
+    for (size_t first = leaves / 2, len = 1; first >= 1; first /= 2, len *= 2) {
+        for (size_t i = first; i < 2 * first; i++) {
+            index->nodes[i] =
+                combine(index->nodes[2 * i], index->nodes[2 * i + 1], len);
+        }
+    }
+
+    return index;
+}
+
+void row_index_free(struct RowIndex *index) {
+    if (!index)
+        return;
+    pthread_mutex_destroy(&index->lock);
+    free(index);
+}
+
+void row_index_set(struct RowIndex *index, size_t col_from, size_t col_to,
+                   int is_free) {
+    size_t free_seats = is_free ? 1 : 0;
+    size_t from = index->leaves + col_from - 1;
+    size_t to = index->leaves + col_to - 1;
+
+    for (size_t i = from; i <= to; i++) {
+        index->nodes[i] = (struct FreeRun){free_seats, free_seats, free_seats};
+    }
+
+    // Recompute the ancestors of the span, one level at a time
+    for (size_t len = 1; from > 1; len *= 2) {
+        from /= 2;
+        to /= 2;
+        for (size_t i = from; i <= to; i++) {
+            index->nodes[i] =
+                combine(index->nodes[2 * i], index->nodes[2 * i + 1], len);
+        }
+    }
+}
+
+size_t row_index_find(const struct RowIndex *index, size_t num_seats) {
+    if (num_seats == 0 || index->nodes[1].best < num_seats) {
+        return 0;
+    }
+
+    // Descend towards the leftmost range holding the run
+    size_t node = 1, start = 1, len = index->leaves;
+    while (node < index->leaves) {
+        const struct FreeRun *left = &index->nodes[2 * node];
+        const struct FreeRun *right = &index->nodes[2 * node + 1];
+        len /= 2;
+
+        if (left->best >= num_seats) {
+            node = 2 * node;
+        } else if (left->suffix + right->prefix >= num_seats) {
+            return start + len - left->suffix;
+        } else {
+            node = 2 * node + 1;
+            start += len;
+        }
+    }
+
+    return start;
+}
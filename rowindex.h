@@ -0,0 +1,50 @@
+#ifndef EMS_ROW_INDEX_H
+#define EMS_ROW_INDEX_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/// Free seats at the edges and longest run of free seats in a range of seats.
+struct FreeRun {
+    size_t prefix; /// Free seats at the start of the range.
+    size_t suffix; /// Free seats at the end of the range.
+    size_t best;   /// Longest run of free seats in the range.
+};
+
+/// Segment tree over the seats of a row. Node 1 covers the whole row and the
+/// children of node i are 2i and 2i+1; seat j is leaf leaves + j - 1.
+struct RowIndex {
+    pthread_mutex_t lock; // Serializes updates from concurrent reservations.
+    size_t cols;          // Number of seats in the row.
+    size_t leaves;        // Number of leaves, a power of two >= cols.
+    struct FreeRun nodes[]; // Array of 2 * leaves nodes.
+};
+
+/// Creates the index of a row with every seat free.
+/// @param cols Number of seats in the row.
+/// @return Newly created index, NULL on failure.
+struct RowIndex *row_index_create(size_t cols);
+
+/// Gets the number of bytes row_index_create() allocates for a row.
+/// @param cols Number of seats in the row.
+/// @return Size of the index.
+size_t row_index_size(size_t cols);
+
+/// Destroys an index.
+void row_index_free(struct RowIndex *index);
+
+/// Marks a span of seats as free or taken.
+/// @param index Index of the row.
+/// @param col_from First column of the span.
+/// @param col_to Last column of the span.
+/// @param is_free Whether the seats are now free.
+void row_index_set(struct RowIndex *index, size_t col_from, size_t col_to,
+                   int is_free);
+
+/// Finds the leftmost run of free seats of a given length.
+/// @param index Index of the row.
+/// @param num_seats Length of the run.
+/// @return First column of the run, 0 if the row has no such run.
+size_t row_index_find(const struct RowIndex *index, size_t num_seats);
+
+#endif // EMS_ROW_INDEX_H
@@ -0,0 +1,393 @@
+#include "scheduler.h"
+#include "affinity.h"
+#include "constants.h"
+#include "operations.h"
+#include "vclock.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ucontext.h>
+
+// AddressSanitizer must be told about every switch between stacks
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define EMS_ASAN 1
+#endif
+#endif
+#if !defined(EMS_ASAN) && defined(__SANITIZE_ADDRESS__)
+#define EMS_ASAN 1
+#endif
+
+#ifdef EMS_ASAN
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+// Worker states
+#define WORKER_RUNNABLE 0
+#define WORKER_SLEEPING 1
+#define WORKER_DONE 2
+#define WORKER_YIELDED 3
+
+/// A logical worker and the coroutine it runs on.
+struct Worker {
+    ucontext_t context;        // Saved context while suspended.
+    ucontext_t *carrier;       // Context of the carrier running the worker.
+    void *stack;               // Stack of the coroutine.
+    void *fake_stack;          // ASan fake stack saved while suspended.
+    const void *carrier_stack; // Stack of the carrier running the worker.
+    size_t carrier_stack_size; // Size of carrier_stack.
+    int state;                 // One of the worker states.
+    struct timespec wake;      // Wake up time while sleeping.
+    void *arg;                 // Argument of the routine.
+    int result;                // Value returned by the routine.
+};
+
+/// Workers of a sched_run() call and the queue of runnable workers.
+struct Scheduler {
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // Signaled when a worker becomes runnable or sleeps.
+    int (*routine)(void *);
+    struct Worker *workers;
+    size_t num_workers;
+    size_t num_carriers;
+    size_t live;           // Workers that have not returned.
+    size_t sleeping;       // Workers waiting for their wake up time.
+    struct Worker **queue; // Ring of runnable workers.
+    size_t head;           // Position of the next worker to run.
+    size_t count;          // Number of queued workers.
+};
+
+/// Scheduler of the current sched_run() call.
+static struct Scheduler *scheduler = NULL;
+
+/// Worker running on the calling carrier thread, NULL outside a worker.
+static _Thread_local struct Worker *current_worker = NULL;
+
+/// Returns whether a time is earlier than another.
+static int time_before(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec < b->tv_sec ||
+           (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/// Appends a worker to the run queue.
+/// @note The caller must hold the scheduler's lock.
+static void enqueue_worker(struct Worker *worker) {
+    size_t tail = (scheduler->head + scheduler->count) % scheduler->num_workers;
+    scheduler->queue[tail] = worker;
+    scheduler->count++;
+    worker->state = WORKER_RUNNABLE;
+}
+
+/// Queues every sleeping worker whose wake up time has passed.
+/// @note The caller must hold the scheduler's lock.
+/// @param next Set to the earliest wake up time of the workers still asleep.
+static void wake_workers(struct timespec *next) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int found = 0;
+    for (size_t i = 0; i < scheduler->num_workers; i++) {
+        struct Worker *worker = &scheduler->workers[i];
+        if (worker->state != WORKER_SLEEPING) {
+            continue;
+        }
+
+        if (!time_before(&now, &worker->wake)) {
+            scheduler->sleeping--;
+            enqueue_worker(worker);
+        } else if (!found || time_before(&worker->wake, next)) {
+            *next = worker->wake;
+            found = 1;
+        }
+    }
+}
+
+/// Moves the queued worker with the earliest simulated time to the head of
+/// the run queue, the lowest index first among equal times, so that workers
+/// run in simulated time order whatever their order in the queue.
+/// @note The caller must hold the scheduler's lock.
+static void select_earliest_worker() {
+    size_t best = scheduler->head;
+    for (size_t i = 1; i < scheduler->count; i++) {
+        size_t pos = (scheduler->head + i) % scheduler->num_workers;
+        struct Worker *worker = scheduler->queue[pos];
+        struct Worker *earliest = scheduler->queue[best];
+        int id = (int)(worker - scheduler->workers) + 1;
+        int earliest_id = (int)(earliest - scheduler->workers) + 1;
+
+        if (vclock_time(id) < vclock_time(earliest_id) ||
+            (vclock_time(id) == vclock_time(earliest_id) &&
+             id < earliest_id)) {
+            best = pos;
+        }
+    }
+
+    struct Worker *worker = scheduler->queue[best];
+    scheduler->queue[best] = scheduler->queue[scheduler->head];
+    scheduler->queue[scheduler->head] = worker;
+}
+
+/// Tells ASan the calling thread is about to switch to another stack.
+/// @param fake_stack Set to the fake stack of the current stack, NULL if the
+/// current stack is never switched back to.
+/// @param bottom Lowest address of the stack switched to.
+/// @param size Size of the stack switched to.
+static void start_switch(void **fake_stack, const void *bottom, size_t size) {
+#ifdef EMS_ASAN
+    __sanitizer_start_switch_fiber(fake_stack, bottom, size);
+#else
+    (void)fake_stack;
+    (void)bottom;
+    (void)size;
+#endif
+}
+
+/// Tells ASan the calling thread has switched back to a stack.
+/// @param fake_stack Fake stack saved by start_switch() when switching away.
+/// @param bottom Set to the lowest address of the stack switched from, unless
+/// NULL.
+/// @param size Set to the size of the stack switched from, unless NULL.
+static void finish_switch(void *fake_stack, const void **bottom,
+                          size_t *size) {
+#ifdef EMS_ASAN
+    __sanitizer_finish_switch_fiber(fake_stack, bottom, size);
+#else
+    (void)fake_stack;
+    (void)bottom;
+    (void)size;
+#endif
+}
+
+/// Saves the current context and switches to another, like swapcontext().
+/// @param from Set to the current context, which resumes by returning.
+/// @param to Context to switch to.
+static void switch_context(ucontext_t *from, const ucontext_t *to) {
+#ifdef EMS_ASAN
+    // The swapcontext() interceptor of ASan warns that it cannot follow the
+    // switch, which start_switch() and finish_switch() already describe
+    volatile int switched = 0;
+    getcontext(from);
+    if (!switched) {
+        switched = 1;
+        setcontext(to);
+    }
+#else
+    swapcontext(from, to);
+#endif
+}
+
+/// Suspends a worker, handing its carrier back.
+/// @param worker Worker running on the calling carrier.
+static void switch_to_carrier(struct Worker *worker) {
+    // A worker that has returned is never resumed
+    start_switch(worker->state == WORKER_DONE ? NULL : &worker->fake_stack,
+                 worker->carrier_stack, worker->carrier_stack_size);
+    switch_context(&worker->context, worker->carrier);
+    finish_switch(worker->fake_stack, &worker->carrier_stack,
+                  &worker->carrier_stack_size);
+}
+
+/// Entry point of a worker's coroutine.
+/// @param index Index of the worker.
+static void run_worker(int index) {
+    struct Worker *worker = &scheduler->workers[index];
+    finish_switch(NULL, &worker->carrier_stack, &worker->carrier_stack_size);
+
+    worker->result = scheduler->routine(worker->arg);
+    worker->state = WORKER_DONE;
+
+    // Hand the carrier back for good
+    switch_to_carrier(worker);
+}
+
+/// Runs queued workers until every worker has returned.
+/// @param arg Index of the carrier.
+static void *run_carrier(void *arg) {
+    ucontext_t context;
+
+    affinity_pin_carrier((size_t)(uintptr_t)arg, scheduler->num_carriers);
+
+    pthread_mutex_lock(&scheduler->lock);
+    while (scheduler->live > 0) {
+        struct timespec next;
+        wake_workers(&next);
+
+        if (scheduler->count == 0) {
+            // Sleep until a worker is queued or the next one wakes up
+            if (scheduler->sleeping > 0) {
+                pthread_cond_timedwait(&scheduler->cond, &scheduler->lock,
+                                       &next);
+            } else {
+                pthread_cond_wait(&scheduler->cond, &scheduler->lock);
+            }
+            continue;
+        }
+
+        if (vclock_enabled()) {
+            select_earliest_worker();
+        }
+
+        struct Worker *worker = scheduler->queue[scheduler->head];
+        scheduler->head = (scheduler->head + 1) % scheduler->num_workers;
+        scheduler->count--;
+        pthread_mutex_unlock(&scheduler->lock);
+
+        worker->carrier = &context;
+        current_worker = worker;
+        vclock_thread((int)(worker - scheduler->workers) + 1);
+        void *fake_stack;
+        start_switch(&fake_stack, worker->stack, WORKER_STACK_SIZE);
+        switch_context(&context, &worker->context);
+        finish_switch(fake_stack, NULL, NULL);
+        current_worker = NULL;
+
+        pthread_mutex_lock(&scheduler->lock);
+        if (worker->state == WORKER_DONE) {
+            scheduler->live--;
+        } else if (worker->state == WORKER_SLEEPING) {
+            scheduler->sleeping++;
+        } else if (worker->state == WORKER_YIELDED) {
+            enqueue_worker(worker);
+        }
+
+        // Let idle carriers recompute their timeout, or exit
+        pthread_cond_broadcast(&scheduler->cond);
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+
+    return NULL;
+}
+
+// Let the workers earlier in simulated time run first
+void sched_yield_worker() {
+    struct Worker *worker = current_worker;
+    if (worker == NULL || !vclock_enabled()) {
+        return;
+    }
+
+    worker->state = WORKER_YIELDED;
+    switch_to_carrier(worker);
+}
+
+// Suspend the calling worker for a delay
+void sched_wait(unsigned int delay_ms) {
+    struct Worker *worker = current_worker;
+    if (worker == NULL) {
+        ems_wait(delay_ms);
+        return;
+    }
+
+    // With the virtual clock, the delay is simulated and the worker yields
+    // so that the workers earlier in simulated time run first
+    if (vclock_enabled()) {
+        vclock_advance(delay_ms);
+        sched_yield_worker();
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &worker->wake);
+    worker->wake.tv_sec += delay_ms / 1000;
+    worker->wake.tv_nsec += (long)(delay_ms % 1000) * 1000000;
+    if (worker->wake.tv_nsec >= 1000000000) {
+        worker->wake.tv_sec++;
+        worker->wake.tv_nsec -= 1000000000;
+    }
+    worker->state = WORKER_SLEEPING;
+
+    // The worker may be resumed by another carrier, so only the worker itself
+    // is used after the switch
+    switch_to_carrier(worker);
+}
+
+// Run logical workers on a pool of carrier threads
+int sched_run(size_t num_workers, size_t num_carriers, int (*routine)(void *),
+              void **args, int *results) {
+    if (num_workers == 0) {
+        return 0;
+    }
+    if (num_carriers == 0 || num_carriers > num_workers) {
+        num_carriers = num_workers;
+    }
+    if (vclock_enabled()) {
+        num_carriers = 1; // Only one worker runs at a time in simulated time
+    }
+
+    struct Scheduler sched;
+    sched.routine = routine;
+    sched.num_workers = num_workers;
+    sched.num_carriers = num_carriers;
+    sched.live = num_workers;
+    sched.sleeping = 0;
+    sched.head = 0;
+    sched.count = 0;
+    sched.workers = calloc(num_workers, sizeof(struct Worker));
+    sched.queue = malloc(num_workers * sizeof(struct Worker *));
+    pthread_t *carriers = malloc(num_carriers * sizeof(pthread_t));
+
+    if (sched.workers == NULL || sched.queue == NULL || carriers == NULL) {
+        fprintf(stderr, "Error allocating memory for workers\n");
+        free(sched.workers);
+        free(sched.queue);
+        free(carriers);
+        return 1;
+    }
+
+    pthread_mutex_init(&sched.lock, NULL);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sched.cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    scheduler = &sched;
+
+    int result = 0;
+    for (size_t i = 0; i < num_workers; i++) {
+        struct Worker *worker = &sched.workers[i];
+        worker->arg = args[i];
+        worker->stack = malloc(WORKER_STACK_SIZE);
+
+        if (worker->stack == NULL || getcontext(&worker->context) != 0) {
+            fprintf(stderr, "Error creating worker\n");
+            result = 1;
+            break;
+        }
+
+        worker->context.uc_stack.ss_sp = worker->stack;
+        worker->context.uc_stack.ss_size = WORKER_STACK_SIZE;
+        worker->context.uc_link = NULL;
+        makecontext(&worker->context, (void (*)(void))run_worker, 1, (int)i);
+        enqueue_worker(worker);
+    }
+
+    // Start the carriers, the calling thread being the first one
+    size_t started = 1;
+    if (result == 0) {
+        for (; started < num_carriers; started++) {
+            if (pthread_create(&carriers[started], NULL, run_carrier,
+                               (void *)(uintptr_t)started) != 0) {
+                perror("Error creating thread");
+                break;
+            }
+        }
+        run_carrier((void *)(uintptr_t)0);
+    }
+
+    for (size_t i = 1; i < started; i++) {
+        pthread_join(carriers[i], NULL);
+    }
+
+    for (size_t i = 0; i < num_workers; i++) {
+        results[i] = sched.workers[i].result;
+        free(sched.workers[i].stack);
+    }
+
+    scheduler = NULL;
+    pthread_cond_destroy(&sched.cond);
+    pthread_mutex_destroy(&sched.lock);
+    free(sched.workers);
+    free(sched.queue);
+    free(carriers);
+    return result;
+}
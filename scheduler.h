@@ -0,0 +1,32 @@
+#ifndef EMS_SCHEDULER_H
+#define EMS_SCHEDULER_H
+
+#include <stddef.h>
+
+/// Runs logical workers as coroutines on a pool of carrier threads, until
+/// every worker has returned. A worker only leaves its carrier when it
+/// returns or calls sched_wait() or sched_yield_worker(), so it must not wait
+/// while holding a lock.
+/// With the virtual clock, worker i runs logical thread i + 1 of vclock.h
+/// and a single carrier runs the worker with the earliest simulated time.
+/// @param num_workers Number of logical workers.
+/// @param num_carriers Number of carrier threads, at most num_workers are used.
+/// @param routine Function run by each worker.
+/// @param args Argument passed to the routine of each worker.
+/// @param results Value returned by the routine of each worker.
+/// @return 0 if every worker ran to completion, 1 otherwise.
+int sched_run(size_t num_workers, size_t num_carriers, int (*routine)(void *),
+              void **args, int *results);
+
+/// Suspends the calling worker for a delay, letting its carrier run other
+/// workers. Outside a worker, sleeps the calling thread instead. With the
+/// virtual clock, advances the worker's simulated time and yields instead.
+/// @param delay_ms Delay in milliseconds.
+void sched_wait(unsigned int delay_ms);
+
+/// With the virtual clock, suspends the calling worker until it is again the
+/// earliest in simulated time, so that workers take turns between commands
+/// and not only at their WAITs. Does nothing otherwise.
+void sched_yield_worker();
+
+#endif // EMS_SCHEDULER_H
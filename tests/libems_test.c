@@ -0,0 +1,169 @@
+/*
+Test of the library interface of EMS and of the in-memory streams it runs on.
+Creates, reserves and shows events entirely from memory, with no files or
+child processes, and checks every result.
+
+Usage: ./tests/libems_test
+*/
+
+#include "contention.h"
+#include "libems.h"
+#include "memio.h"
+#include "memory.h"
+#include "operations.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failed = 0;
+
+/// Reports a failed check.
+static void fail(const char *check) {
+    printf("FAIL: libems: %s\n", check);
+    failed = 1;
+}
+
+/// Runs commands on one thread and compares their results with the
+/// expected ones.
+/// @param check Name of the check.
+/// @param commands Commands, one per line.
+/// @param expected Expected results.
+static void expect_run(const char *check, const char *commands,
+                       const char *expected) {
+    char output[256];
+    size_t length;
+    if (libems_run(commands, strlen(commands), 1, output, sizeof(output),
+                   &length) != 0 ||
+        length != strlen(expected) || memcmp(output, expected, length) != 0) {
+        fail(check);
+    }
+}
+
+/// Checks that results that do not fit in the buffer are cut, and that
+/// their full length is still reported.
+static void check_truncation() {
+    const char *commands = "SHOW 1\n";
+    char output[8];
+    memset(output, '#', sizeof(output));
+
+    size_t length;
+    if (libems_run(commands, strlen(commands), 1, output, 5, &length) == 0 ||
+        length != strlen("1 0 0 \n0 0 1 \n") ||
+        memcmp(output, "1 0 0###", sizeof(output)) != 0) {
+        fail("truncated output");
+    }
+}
+
+/// Reads and writes the in-memory streams directly, and shows an event
+/// into one through the operations API.
+static void check_streams() {
+    const char data[] = "RESERVE 1 [(1,2)]\n";
+    int in_fd = memio_open_input(data, strlen(data));
+    char buffer[32];
+    if (in_fd >= -1 || io_read(in_fd, buffer, 7) != 7 ||
+        memcmp(buffer, "RESERVE", 7) != 0 ||
+        io_seek(in_fd, -2, SEEK_END) != 16 ||
+        io_read(in_fd, buffer, sizeof(buffer)) != 2 ||
+        io_read(in_fd, buffer, sizeof(buffer)) != 0 || io_close(in_fd) != 0) {
+        fail("input stream");
+    }
+
+    char output[16];
+    int out_fd = memio_open_output(output, sizeof(output));
+    if (out_fd >= -1 || ems_show(1, out_fd) != 0 ||
+        memio_length(out_fd) != 14 ||
+        memcmp(output, "1 0 0 \n0 0 1 \n", 14) != 0 ||
+        io_write(out_fd, "overflow", 8) != 8 || memio_length(out_fd) != 22 ||
+        io_close(out_fd) != 0) {
+        fail("output stream");
+    }
+}
+
+/// Recreates event 1 with other dimensions after EMS is terminated and
+/// initialized again. The calling thread, which is also the first carrier
+/// of every call, still holds a cached handle to the old event, which must
+/// not be used.
+static void check_reinit() {
+    if (libems_terminate() != 0 || libems_init(0, 1) != 0) {
+        fail("terminate and init again");
+        return;
+    }
+
+    expect_run("event recreated after init",
+               "CREATE 1 1 4\nRESERVE 1 [(1,4)]\nSHOW 1\n", "0 0 0 1 \n");
+
+    char output[16];
+    int out_fd = memio_open_output(output, sizeof(output));
+    if (ems_show(1, out_fd) != 0 || memio_length(out_fd) != 9 ||
+        memcmp(output, "0 0 0 1 \n", 9) != 0) {
+        fail("show of the recreated event");
+    }
+    io_close(out_fd);
+}
+
+/// Counts the contention of an event, whose counters must be accounted
+/// against the memory budget while it exists and released with it.
+static void check_contention_memory() {
+    contention_configure(2);
+    if (libems_terminate() != 0 || libems_init(0, 1) != 0) {
+        fail("terminate and init with contention counters");
+        return;
+    }
+
+    // The second reservation conflicts, allocating the seat counters
+    expect_run("conflicting reservation",
+               "CREATE 1 2 3\nRESERVE 1 [(1,1)]\nRESERVE 1 [(1,1)]\n", "");
+    size_t used = memory_current();
+
+    char output[128];
+    int out_fd = memio_open_output(output, sizeof(output));
+    const char *expected = "Event 1: 0 waits, 1 conflicts\nHot rows:\n"
+                           "  Row 1: 0 waits, 1 conflicts\nHot seats:\n"
+                           "  Seat (1,1): 0 waits, 1 conflicts\n";
+    if (ems_contention_report(out_fd) != 0 ||
+        memio_length(out_fd) != strlen(expected) ||
+        memcmp(output, expected, strlen(expected)) != 0) {
+        fail("contention report");
+    }
+    io_close(out_fd);
+
+    contention_configure(0);
+    if (libems_terminate() != 0 || memory_current() != 0 ||
+        libems_init(0, 1) != 0) {
+        fail("contention counters released");
+        return;
+    }
+
+    // The same event without counters uses less memory
+    expect_run("reservation without counters",
+               "CREATE 1 2 3\nRESERVE 1 [(1,1)]\nRESERVE 1 [(1,1)]\n", "");
+    if (memory_current() >= used) {
+        fail("contention counters accounted");
+    }
+}
+
+int main() {
+    if (libems_init(0, 1) != 0) {
+        fail("init");
+        return 1;
+    }
+
+    expect_run("create and show",
+               "CREATE 1 2 3\nRESERVE 1 [(1,1) (2,3)]\nSHOW 1\n",
+               "1 0 0 \n0 0 1 \n");
+
+    // Events persist from one call to the next
+    expect_run("show from a later call", "SHOW 1\n", "1 0 0 \n0 0 1 \n");
+    expect_run("reserve best", "RESERVE_BEST 1 2\nSHOW 1\n",
+               "Reserved 2: (1,2)-(1,3)\n1 2 2 \n0 0 1 \n");
+    expect_run("cancel", "CANCEL 1 2\nSHOW 1\n", "1 0 0 \n0 0 1 \n");
+
+    check_truncation();
+    check_streams();
+    check_reinit();
+    check_contention_memory();
+
+    if (libems_terminate() != 0) {
+        fail("terminate");
+    }
+    return failed;
+}
@@ -0,0 +1,374 @@
+#!/bin/bash
+# Runs the tests: every .jobs file of tests/ against its .result, with the
+# default options, and then the checks of the options that change behavior.
+# Each check runs ems in its own scratch directory, so tests/ is left as is.
+
+cd "$(dirname "$0")/.." || exit 1
+
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+failed=0
+
+# Reports a failed check.
+fail() {
+    echo "FAIL: $*"
+    failed=1
+}
+
+# Creates a scratch directory for a check and prints its path.
+# Usage: new_dir <name> [files to copy into it...]
+new_dir() {
+    local dir="$scratch/$1"
+    mkdir -p "$dir"
+    shift
+    [ $# -eq 0 ] || cp "$@" "$dir"
+    echo "$dir"
+}
+
+# Runs ems, appending what it prints to the log of the check.
+# Usage: run_ems <dir> <arguments...>
+run_ems() {
+    local dir=$1
+    shift
+    ./ems "$@" >>"$dir/ems.log" 2>&1
+}
+
+# Compares the .out file of every .jobs file of a directory that has a
+# .result with it. The .result files leave out the space after the last seat
+# of each row.
+# Usage: check_results <dir> <check name>
+check_results() {
+    for jobs in "$1"/*.jobs; do
+        local base=${jobs%.jobs}
+        if [ -f "$base.result" ] &&
+            ! diff -qZ "$base.out" "$base.result" >/dev/null 2>&1; then
+            fail "$2: $(basename "$base").out differs from its .result"
+        fi
+    done
+}
+
+# Compares a file with the output of printf.
+# Usage: expect_file <file> <check name> <printf format> [arguments...]
+expect_file() {
+    local file=$1 name=$2
+    shift 2
+    # shellcheck disable=SC2059
+    if ! cmp -s "$file" <(printf "$@"); then
+        fail "$name: unexpected $(basename "$file")"
+    fi
+}
+
+# Runs ems with an invalid option value, which must make it fail before it
+# processes any file.
+# Usage: expect_rejected <check name> <options...>
+expect_rejected() {
+    local name=$1
+    shift
+    if ./ems "$@" "$(new_dir rejected)" >/dev/null 2>&1; then
+        fail "$name: $* was accepted"
+    fi
+}
+
+# The .jobs files, with the default options
+dir=$(new_dir default tests/*.jobs tests/*.result)
+run_ems "$dir" "$dir" 4 1
+check_results "$dir" default
+
+# auto: the number of processes is chosen from the files, and reported
+dir=$(new_dir auto tests/[1-3].jobs tests/[1-3].result)
+run_ems "$dir" "$dir" auto 1
+check_results "$dir" auto
+grep -q "^Auto configuration: [1-9][0-9]* processes" "$dir/ems.log" ||
+    fail "auto: the chosen counts were not reported"
+
+# Every count and numeric option takes a positive decimal number
+for value in 0 abc -1 2x ''; do
+    if ./ems "$(new_dir rejected)" "$value" 1 >/dev/null 2>&1; then
+        fail "counts: $value processes were accepted"
+    fi
+    if ./ems "$(new_dir rejected)" 1 "$value" >/dev/null 2>&1; then
+        fail "counts: $value threads were accepted"
+    fi
+    for option in -c -m -H; do
+        expect_rejected counts "$option" "$value"
+    done
+done
+
+# -w: the log is replayed by the next run, and a torn record at its end is
+# cut off, so the records appended after it are recovered too
+dir=$(new_dir wal)
+printf 'CREATE 1 3 3\nRESERVE 1 [(1,1)]\n' >"$dir/log.jobs"
+run_ems "$dir" -w 10 "$dir"
+printf '\005' >>"$dir/log.wal" # Length of a record that was never written
+printf 'RESERVE 1 [(3,3)]\n' >"$dir/log.jobs"
+run_ems "$dir" -w 10 "$dir"
+printf 'SHOW 1\n' >"$dir/log.jobs"
+run_ems "$dir" -w 10 "$dir"
+expect_file "$dir/log.out" wal '1 0 0 \n0 0 0 \n0 0 2 \n'
+grep -q "recovered 3 operations" "$dir/ems.log" ||
+    fail "wal: the third run did not recover every operation"
+for value in 0 abc 10ms -1; do
+    expect_rejected wal -w "$value"
+    expect_rejected wal -w 10 -b "$value"
+done
+
+# -w: a logged group of reservations across events is replayed whole or not
+# at all. The log creates event 1 and then reserves seat (1,1) of events 1
+# and 2, which does not exist
+dir=$(new_dir wal-multi)
+printf '\005\000\001\001\002\002' >"$dir/multi.wal"
+printf '\017\001\004\002\001\001\001\001\001\000\002\001\001\001\001\000' \
+    >>"$dir/multi.wal"
+printf 'SHOW 1\n' >"$dir/multi.jobs"
+run_ems "$dir" -w 10 "$dir"
+expect_file "$dir/multi.out" wal-multi '0 0 \n0 0 \n'
+
+# A RESERVE or RESERVE_MULTI cut short by the end of its file is rejected,
+# as it always was, which the next run sees in the log
+for reserve in 'RESERVE 1 [(1,1)]' 'RESERVE_MULTI 1 [(1,1)]'; do
+    dir=$(new_dir "unterminated-${reserve%% *}")
+    printf 'CREATE 1 1 2\n%s' "$reserve" >"$dir/cut.jobs"
+    run_ems "$dir" -w 10 "$dir"
+    printf 'SHOW 1\n' >"$dir/cut.jobs"
+    run_ems "$dir" -w 10 "$dir"
+    expect_file "$dir/cut.out" "unterminated ${reserve%% *}" '0 0 \n'
+done
+
+# -m: reserving a seat of a wide row only charges its tile, and RESERVE_BEST
+# builds the index of the rows it scans from the seats already taken
+dir=$(new_dir row-index)
+printf '%s\n' 'CREATE 1 1 100000' 'RESERVE 1 [(1,1)]' 'CREATE 2 2 70' \
+    'RESERVE 2 [(1,2) (1,63) (1,64) (1,65)]' 'RESERVE_BEST 2 6' \
+    'RESERVE_BEST 2 61' 'SHOW 1 1-1 1-3' 'SHOW 2 1-2 60-70' >"$dir/best.jobs"
+run_ems "$dir" -m 100000 "$dir"
+expect_file "$dir/best.out" row-index '%s\n' 'Reserved 2: (1,3)-(1,8)' \
+    'Reserved 3: (2,1)-(2,61)' '1 0 0 ' '0 0 0 1 1 1 0 0 0 0 0 ' \
+    '3 3 0 0 0 0 0 0 0 0 0 '
+
+# -m: a reservation needing a tile past the budget and a CREATE whose tables
+# do not fit are rejected, and the event keeps the seats it got
+dir=$(new_dir budget)
+printf '%s\n' 'CREATE 1 2 70' 'RESERVE 1 [(1,1)]' 'RESERVE 1 [(1,70)]' \
+    'CREATE 2 100000 100000' 'SHOW 2' 'SHOW 1' >"$dir/budget.jobs"
+run_ems "$dir" -m 30000 "$dir"
+expect_file "$dir/budget.out" budget '1%s \n%s \n' \
+    "$(printf ' 0%.0s' $(seq 69))" "0$(printf ' 0%.0s' $(seq 69))"
+grep -q "Event exceeds memory budget" "$dir/ems.log" ||
+    fail "budget: the large CREATE was not rejected"
+peak=$(sed -n 's/.*used [0-9]* bytes for events, peak \([0-9]*\)$/\1/p' \
+    "$dir/ems.log")
+if [ -z "$peak" ] || [ "$peak" -gt 30000 ]; then
+    fail "budget: peak of ${peak:-no} bytes over the budget"
+fi
+
+# -m: the copy a reservation keeps for CANCEL and the render a SHOW keeps are
+# charged too. A reservation whose copy does not fit fails as a whole, and a
+# SHOW whose render does not fit is printed without being kept
+dir=$(new_dir budget-copies)
+printf '%s\n' 'CREATE 1 2 3' 'RESERVE 1 [(1,1)]' >"$dir/copies.jobs"
+run_ems "$dir" "$dir"
+reserved=$(sed -n 's/.*used \([0-9]*\) bytes for events.*/\1/p' \
+    "$dir/ems.log" | tail -n 1)
+printf '%s\n' 'CREATE 1 2 3' 'RESERVE 1 [(1,1)]' 'SHOW 1' 'CANCEL 1 1' \
+    'SHOW 1' >"$dir/copies.jobs"
+run_ems "$dir" -m "$((reserved - 1))" "$dir"
+expect_file "$dir/copies.out" budget-copies '0 0 0 \n0 0 0 \n0 0 0 \n0 0 0 \n'
+grep -q "Reservation not found" "$dir/ems.log" ||
+    fail "budget-copies: the reservation without a copy was booked"
+printf '%s\n' 'CREATE 1 2 3' 'RESERVE 1 [(1,1)]' 'SHOW 1' 'SHOW 1' \
+    >"$dir/copies.jobs"
+run_ems "$dir" -m "$reserved" "$dir"
+expect_file "$dir/copies.out" budget-copies '1 0 0 \n0 0 0 \n1 0 0 \n0 0 0 \n'
+run_ems "$dir" "$dir"
+used=$(sed -n 's/.*used \([0-9]*\) bytes for events.*/\1/p' \
+    "$dir/ems.log" | tail -n 2)
+if [ "$(echo "$used" | head -n 1)" -ne "$reserved" ] ||
+    [ "$(echo "$used" | tail -n 1)" -le "$reserved" ]; then
+    fail "budget-copies: the render was not charged to the budget"
+fi
+
+# -m: a range SHOW prints the seats of tiles never reserved as free without
+# allocating them, so it fits in a budget the whole event would not
+dir=$(new_dir show-range)
+printf '%s\n' 'CREATE 1 10 10' 'SHOW 1 1-10 1-10' 'RESERVE 1 [(10,10)]' \
+    'SHOW 1 9-10 9-10' >"$dir/range.jobs"
+run_ems "$dir" -m 30000 "$dir"
+expect_file "$dir/range.out" show-range '%s\n0 0 \n0 1 \n' \
+    "$(printf '0 0 0 0 0 0 0 0 0 0 \n%.0s' $(seq 10))"
+
+# -H: conflicts are counted per row and per seat, and the counters are
+# charged to -m, a row whose seat counters do not fit only counted as a whole
+dir=$(new_dir contention)
+printf '%s\n' 'CREATE 1 2 3' 'RESERVE 1 [(1,1)]' 'RESERVE 1 [(1,1) (2,2)]' \
+    'RESERVE 1 [(2,3) (1,1)]' >"$dir/hot.jobs"
+run_ems "$dir" -H 2 "$dir" 1 1
+expect_file "$dir/hot.contention" contention '%s\n' \
+    'Event 1: 0 waits, 2 conflicts' 'Hot rows:' \
+    '  Row 1: 0 waits, 2 conflicts' 'Hot seats:' \
+    '  Seat (1,1): 0 waits, 2 conflicts'
+used=$(sed -n 's/.*used \([0-9]*\) bytes for events.*/\1/p' "$dir/ems.log")
+run_ems "$dir" -H 2 -m "$((used - 1))" "$dir" 1 1
+expect_file "$dir/hot.contention" contention '%s\n' \
+    'Event 1: 0 waits, 2 conflicts' 'Hot rows:' '  Row 1: 0 waits, 2 conflicts'
+run_ems "$dir" "$dir" 1 1
+without=$(sed -n 's/.*used \([0-9]*\) bytes for events.*/\1/p' \
+    "$dir/ems.log" | tail -n 1)
+if [ -z "$used" ] || [ "$without" -ge "$used" ]; then
+    fail "contention: the counters were not charged to the budget"
+fi
+
+# -c: more threads than carriers, the workers moving between carriers each
+# time they wait, with ASan told about every switch of stacks
+dir=$(new_dir carriers)
+printf '%s\n' 'CREATE 1 2 3' 'CREATE 2 2 3' 'CREATE 3 2 3' BARRIER \
+    'RESERVE 1 [(1,1) (2,3)]' 'RESERVE 2 [(1,2)]' 'RESERVE 3 [(2,1) (2,2)]' \
+    BARRIER 'SHOW 1' BARRIER 'SHOW 2' BARRIER 'SHOW 3' >"$dir/carriers.jobs"
+run_ems "$dir" -c 2 "$dir" 1 6
+expect_file "$dir/carriers.out" carriers '%s\n' '1 0 0 ' '0 0 1 ' '0 1 0 ' \
+    '0 0 0 ' '0 0 0 ' '1 1 0 '
+if grep -q "makecontext/swapcontext" "$dir/ems.log"; then
+    fail "carriers: ASan could not follow the switches of stacks"
+fi
+
+# -c: a file indexed in one chunk or in seven, whose boundaries fall in the
+# middle of lines, runs the same commands. The virtual clock makes the order
+# of the threads, and so the reservation ids, the same in both runs
+dir=$(new_dir chunks)
+{
+    printf 'CREATE 1 40 50\nBARRIER\n'
+    for row in $(seq 40); do
+        for col in $(seq 50); do
+            echo "RESERVE 1 [($row,$col)]"
+        done
+        echo BARRIER
+    done
+    echo 'SHOW 1'
+} >"$dir/big.jobs"
+run_ems "$dir" -v -c 1 "$dir" 1 3
+mv "$dir/big.out" "$dir/one-chunk.txt"
+run_ems "$dir" -v -c 7 "$dir" 1 3
+cmp -s "$dir/big.out" "$dir/one-chunk.txt" ||
+    fail "chunks: the output depends on the number of chunks"
+if [ "$(wc -l <"$dir/big.out")" -ne 40 ] || grep -qw 0 "$dir/big.out"; then
+    fail "chunks: some reservations were not made"
+fi
+
+# The files after the one being processed are read ahead. A .jobs link to a
+# missing file among them only fails its own child
+dir=$(new_dir readahead tests/[1-6].jobs tests/[1-6].result)
+ln -s missing.jobs "$dir/0.jobs"
+ln -s missing.jobs "$dir/7.jobs"
+run_ems "$dir" "$dir" 2 1 || fail "readahead: the run failed"
+check_results "$dir" readahead
+[ "$(grep -c "Error opening job file" "$dir/ems.log")" -eq 2 ] ||
+    fail "readahead: the missing files were not reported"
+
+# -f binary: ems-decode turns every binary SHOW back into the text one
+dir=$(new_dir binary tests/*.jobs tests/*.result)
+run_ems "$dir" -f binary "$dir" 4 1
+binary_shows=0
+for jobs in "$dir"/*.jobs; do
+    base=${jobs%.jobs}
+    cmp -s "$base.out" "$base.result" || binary_shows=$((binary_shows + 1))
+    ./ems-decode "$base.out" >"$base.decoded" 2>>"$dir/ems.log" &&
+        diff -qZ "$base.decoded" "$base.result" >/dev/null ||
+        fail "binary: $(basename "$base") does not decode to its .result"
+done
+[ $binary_shows -gt 0 ] || fail "binary: no SHOW was written in binary"
+
+# -v: the threads take turns at every command in simulated time order, the
+# lowest thread first among ties, so every run prints the same
+dir=$(new_dir vclock)
+printf '%s\n' 'CREATE 1 4 8' BARRIER 'RESERVE_BEST 1 2' 'RESERVE_BEST 1 3' \
+    'RESERVE_BEST 1 1' 'RESERVE_BEST 1 2' 'WAIT 15 2' 'RESERVE_BEST 1 2' \
+    'RESERVE_BEST 1 3' 'RESERVE_BEST 1 1' 'RESERVE_BEST 1 2' 'WAIT 5' \
+    'RESERVE_BEST 1 4' 'RESERVE_BEST 1 4' 'RESERVE_BEST 1 4' \
+    'RESERVE_BEST 1 4' BARRIER 'SHOW 1' >"$dir/turns.jobs"
+for run in 1 2 3; do
+    run_ems "$dir" -v "$dir" 1 4
+    expect_file "$dir/turns.out" "vclock run $run" '%s\n' \
+        'Reserved 1: (1,1)-(1,3)' 'Reserved 2: (1,4)-(1,4)' \
+        'Reserved 3: (1,5)-(1,6)' 'Reserved 4: (1,7)-(1,8)' \
+        'Reserved 5: (2,1)-(2,1)' 'Reserved 6: (2,2)-(2,3)' \
+        'Reserved 7: (2,4)-(2,5)' 'Reserved 8: (2,6)-(2,8)' \
+        'Reserved 9: (3,1)-(3,4)' 'Reserved 10: (3,5)-(3,8)' \
+        'Reserved 11: (4,1)-(4,4)' 'Reserved 12: (4,5)-(4,8)' \
+        '1 1 1 2 3 3 4 4 ' '5 6 6 7 7 8 8 8 ' '9 9 9 9 10 10 10 10 ' \
+        '11 11 11 11 12 12 12 12 '
+done
+
+# -v: consecutive RESERVEs and SHOWs of a thread are not batched, so a line
+# the thread reaches later in simulated time still waits for its turn
+dir=$(new_dir vclock-batch)
+printf '%s\n' 'CREATE 1 1 3' BARRIER 'WAIT 5 1' 'RESERVE 1 [(1,2)]' \
+    'RESERVE 1 [(1,1)]' 'SHOW 1' 'RESERVE 1 [(1,2) (1,3)]' BARRIER \
+    'SHOW 1' >"$dir/batch.jobs"
+run_ems "$dir" -v "$dir" 1 2
+expect_file "$dir/batch.out" vclock-batch '1 2 0 \n1 2 0 \n'
+[ "$(grep -c "Seat already reserved" "$dir/ems.log")" -eq 1 ] ||
+    fail "vclock-batch: not only the last RESERVE failed"
+
+# -a and -p: pinning to the first CPU the tests may run on changes where the
+# carriers run, not what they print, apart from the placement STATS reports
+cpu=$(sed -n 's/^Cpus_allowed_list:[[:space:]]*\([0-9]*\).*/\1/p' \
+    /proc/self/status)
+dir=$(new_dir affinity)
+for jobs in $(grep -L STATS tests/*.jobs); do
+    cp "$jobs" "${jobs%.jobs}.result" "$dir"
+done
+run_ems "$dir" -a "$cpu" -p pack "$dir" 4 1
+check_results "$dir" affinity
+grep -q "pinned to CPUs $cpu, carriers packed" "$dir/ems.log" ||
+    fail "affinity: no placement reported"
+expect_rejected affinity -p diagonal
+expect_rejected affinity -a abc
+expect_rejected affinity -a 0-x
+
+# -t: a timeline of the commands, waits and barriers of every thread, and
+# none without it
+dir=$(new_dir trace)
+printf '%s\n' 'CREATE 1 2 3' BARRIER 'RESERVE 1 [(1,1)]' 'WAIT 5' 'SHOW 1' \
+    >"$dir/trace.jobs"
+run_ems "$dir" -t "$dir" 1 2
+trace=$dir/trace.trace.json
+if [ "$(head -n 1 "$trace" 2>/dev/null)" != '{"traceEvents":[' ]; then
+    fail "trace: no trace written"
+fi
+for span in '"CREATE","cat":"command".*"tid":2' '"RESERVE","cat":"command"' \
+    '"SHOW","cat":"command"' '"WAIT","cat":"wait"' \
+    '"BARRIER wait","cat":"barrier".*"tid":1' \
+    '"BARRIER wait","cat":"barrier".*"tid":2'; do
+    grep -q "$span" "$trace" || fail "trace: no span matching $span"
+done
+if ls "$scratch"/default/*.trace.json >/dev/null 2>&1; then
+    fail "trace: written without -t"
+fi
+
+# bench: every pattern runs to completion and reports its line, and unknown
+# patterns are rejected
+dir=$(new_dir bench)
+./bench -t 2 -n 50 >>"$dir/ems.log" 2>&1 || fail "bench: the run failed"
+for pattern in hotspot samerow disjoint mix; do
+    grep -q "^$pattern " "$dir/ems.log" || fail "bench: no $pattern line"
+done
+if ./bench -t 2 -n 50 diagonal >/dev/null 2>&1; then
+    fail "bench: an unknown pattern was accepted"
+fi
+
+# The library: events created, reserved and shown from memory
+dir=$(new_dir libems)
+./tests/libems_test >>"$dir/ems.log" 2>&1 || {
+    grep FAIL "$dir/ems.log"
+    fail "libems: the driver failed"
+}
+
+# The sanitizers report errors without failing the run
+if grep -rlE "ERROR: (AddressSanitizer|LeakSanitizer)|runtime error" \
+    "$scratch" --include=ems.log; then
+    fail "sanitizer errors in the logs above"
+fi
+
+if [ $failed -eq 0 ]; then
+    echo "All tests passed"
+fi
+exit $failed
@@ -0,0 +1,159 @@
+#include "trace.h"
+#include "constants.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/// A recorded span.
+struct TraceEvent {
+    const char *name;
+    const char *category;
+    uint64_t start; // Trace time in nanoseconds.
+    uint64_t end;
+};
+
+/// Ring of the most recent spans of a logical thread. Only that thread
+/// writes to it, so recording is a store and a release increment.
+struct TraceRing {
+    atomic_size_t head; // Number of spans ever recorded.
+    struct TraceEvent events[TRACE_RING_EVENTS];
+};
+
+static int enabled = 0;
+static struct TraceRing **rings = NULL;
+static int num_rings = 0;
+static uint64_t clock_start = 0;
+
+/// Ring of the logical thread running on the calling OS thread.
+static _Thread_local struct TraceRing *current_ring = NULL;
+
+/// Returns the monotonic clock in nanoseconds.
+static uint64_t clock_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+void trace_configure(int enable) { enabled = enable; }
+
+int trace_enabled() { return enabled; }
+
+// Allocate one ring per logical thread
+int trace_open(int num_threads) {
+    if (!enabled) {
+        return 0;
+    }
+
+    rings = calloc((size_t)num_threads, sizeof(struct TraceRing *));
+    if (rings == NULL) {
+        fprintf(stderr, "Error allocating memory for trace\n");
+        return 1;
+    }
+    num_rings = num_threads;
+
+    for (int i = 0; i < num_threads; i++) {
+        rings[i] = calloc(1, sizeof(struct TraceRing));
+        if (rings[i] == NULL) {
+            fprintf(stderr, "Error allocating memory for trace\n");
+            return 1;
+        }
+    }
+
+    // Time is reported relative to the start of the trace
+    clock_start = clock_ns();
+    return 0;
+}
+
+void trace_thread(int id) {
+    if (rings != NULL && id >= 1 && id <= num_rings) {
+        current_ring = rings[id - 1];
+    }
+}
+
+uint64_t trace_now() {
+    if (!enabled) {
+        return 0;
+    }
+    return clock_ns() - clock_start + 1;
+}
+
+// Record a span that ends now
+void trace_span(const char *name, const char *category, uint64_t start) {
+    struct TraceRing *ring = current_ring;
+    if (start == 0 || ring == NULL) {
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    struct TraceEvent *event = &ring->events[head % TRACE_RING_EVENTS];
+    event->name = name;
+    event->category = category;
+    event->start = start;
+    event->end = trace_now();
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// Record a lock wait that took long enough
+void trace_wait(const char *name, uint64_t start) {
+    if (start != 0 && trace_now() - start >= TRACE_MIN_WAIT_NS) {
+        trace_span(name, "lock", start);
+    }
+}
+
+// Write the recorded spans as Chrome trace-event JSON
+int trace_close(const char *path) {
+    if (rings == NULL) {
+        return 0;
+    }
+
+    int result = 0;
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror("Error opening trace file");
+        result = 1;
+    } else {
+        fprintf(file, "{\"traceEvents\":[\n");
+
+        int first = 1;
+        for (int i = 0; i < num_rings; i++) {
+            struct TraceRing *ring = rings[i];
+            if (ring == NULL) {
+                continue;
+            }
+
+            // Only the most recent spans are kept once a ring wraps
+            size_t head =
+                atomic_load_explicit(&ring->head, memory_order_acquire);
+            size_t from = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS
+                                                   : 0;
+
+            for (size_t j = from; j < head; j++) {
+                struct TraceEvent *event = &ring->events[j % TRACE_RING_EVENTS];
+                fprintf(file,
+                        "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                        "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                        first ? "" : ",\n", event->name, event->category,
+                        (double)event->start / 1000.0,
+                        (double)(event->end - event->start) / 1000.0,
+                        getpid(), i + 1);
+                first = 0;
+            }
+        }
+
+        fprintf(file, "\n]}\n");
+        if (fclose(file) != 0) {
+            perror("Error writing trace file");
+            result = 1;
+        }
+    }
+
+    for (int i = 0; i < num_rings; i++) {
+        free(rings[i]);
+    }
+    free(rings);
+    rings = NULL;
+    num_rings = 0;
+    return result;
+}
@@ -0,0 +1,41 @@
+#ifndef EMS_TRACE_H
+#define EMS_TRACE_H
+
+#include <stdint.h>
+
+/// Enables or disables tracing for the next trace_open().
+void trace_configure(int enabled);
+
+/// Returns whether tracing was enabled with trace_configure().
+int trace_enabled();
+
+/// Allocates one ring buffer per logical thread and starts the trace clock.
+/// @param num_threads Number of logical threads.
+/// @return 0 if the buffers were allocated successfully, 1 otherwise.
+int trace_open(int num_threads);
+
+/// Makes the calling OS thread record into the ring of a logical thread.
+/// Must be called again whenever a logical thread resumes on a carrier.
+/// @param id Logical thread id, starting at 1.
+void trace_thread(int id);
+
+/// Returns the current trace time, 0 if tracing is disabled.
+uint64_t trace_now();
+
+/// Records a span that started at a trace time and ends now.
+/// @param name Name of the span, must outlive the trace.
+/// @param category Category of the span, must outlive the trace.
+/// @param start Trace time returned by trace_now() when the span started.
+void trace_span(const char *name, const char *category, uint64_t start);
+
+/// Records a lock wait, only if it was long enough to be worth showing.
+/// @param name Name of the lock, must outlive the trace.
+/// @param start Trace time returned by trace_now() before locking.
+void trace_wait(const char *name, uint64_t start);
+
+/// Writes every recorded span as Chrome trace-event JSON and frees the rings.
+/// @param path Path of the trace file.
+/// @return 0 if the trace was written successfully, 1 otherwise.
+int trace_close(const char *path);
+
+#endif // EMS_TRACE_H
@@ -0,0 +1,27 @@
+#ifndef EMS_VARINT_H
+#define EMS_VARINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Maximum number of bytes of an encoded 64-bit value.
+#define VARINT_MAX_BYTES 10
+
+/// Gets the number of bytes put_varint() writes for a value.
+size_t varint_size(uint64_t value);
+
+/// Writes a value as a LEB128 varint, 7 bits per byte.
+/// @param out Buffer with room for varint_size(value) bytes.
+/// @param value Value to write.
+/// @return Pointer past the written bytes.
+unsigned char *put_varint(unsigned char *out, uint64_t value);
+
+/// Reads a LEB128 varint and advances past it.
+/// @param in Pointer to the data, advanced past the varint.
+/// @param end End of the data.
+/// @param value Set to the value read.
+/// @return 0 if a value was read, 1 if the varint is truncated or too long.
+int get_varint(const unsigned char **in, const unsigned char *end,
+               uint64_t *value);
+
+#endif // EMS_VARINT_H
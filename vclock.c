@@ -0,0 +1,88 @@
+#include "vclock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static int enabled = 0;
+static uint64_t *clocks = NULL;
+static int num_clocks = 0;
+
+/// Simulated time of the process outside the logical threads, such as while
+/// the write-ahead log is replayed.
+static uint64_t process_clock = 0;
+
+/// Clock of the logical thread running on the calling OS thread.
+static _Thread_local uint64_t *current_clock = NULL;
+
+void vclock_configure(int enable) { enabled = enable; }
+
+int vclock_enabled() { return enabled; }
+
+// Allocate one clock per logical thread
+int vclock_open(int num_threads) {
+    if (!enabled) {
+        return 0;
+    }
+
+    clocks = malloc((size_t)num_threads * sizeof(uint64_t));
+    if (clocks == NULL) {
+        fprintf(stderr, "Error allocating memory for virtual clock\n");
+        return 1;
+    }
+    num_clocks = num_threads;
+
+    for (int i = 0; i < num_threads; i++) {
+        clocks[i] = process_clock;
+    }
+    return 0;
+}
+
+void vclock_thread(int id) {
+    if (clocks != NULL && id >= 1 && id <= num_clocks) {
+        current_clock = &clocks[id - 1];
+    }
+}
+
+void vclock_advance(unsigned int delay_ms) {
+    uint64_t *clock = current_clock != NULL ? current_clock : &process_clock;
+    *clock += (uint64_t)delay_ms * 1000000;
+}
+
+uint64_t vclock_time(int id) {
+    if (clocks == NULL || id < 1 || id > num_clocks) {
+        return process_clock;
+    }
+    return clocks[id - 1];
+}
+
+// Release every logical thread at the time the latest one arrived
+void vclock_barrier() {
+    uint64_t latest = vclock_elapsed();
+    for (int i = 0; i < num_clocks; i++) {
+        clocks[i] = latest;
+    }
+}
+
+uint64_t vclock_elapsed() {
+    uint64_t latest = process_clock;
+    for (int i = 0; i < num_clocks; i++) {
+        if (clocks[i] > latest) {
+            latest = clocks[i];
+        }
+    }
+    return latest;
+}
+
+void vclock_close() {
+    process_clock = vclock_elapsed();
+    free(clocks);
+    clocks = NULL;
+    num_clocks = 0;
+    current_clock = NULL;
+}
+
+uint64_t vclock_cpu_time() {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
@@ -0,0 +1,48 @@
+#ifndef EMS_VCLOCK_H
+#define EMS_VCLOCK_H
+
+#include <stdint.h>
+
+/// Enables or disables the virtual clock. With it, WAITs and state access
+/// delays advance a simulated clock of the logical thread instead of
+/// sleeping, and the logical threads of a process run in simulated time
+/// order on a single carrier.
+void vclock_configure(int enabled);
+
+/// Returns whether the virtual clock was enabled with vclock_configure().
+int vclock_enabled();
+
+/// Allocates the clocks of the logical threads, starting at the simulated
+/// time the process already spent.
+/// @param num_threads Number of logical threads.
+/// @return 0 if the clocks were allocated successfully, 1 otherwise.
+int vclock_open(int num_threads);
+
+/// Makes the calling OS thread advance the clock of a logical thread.
+/// Must be called again whenever a logical thread resumes on a carrier.
+/// @param id Logical thread id, starting at 1.
+void vclock_thread(int id);
+
+/// Advances the clock of the calling logical thread, or of the process
+/// outside a logical thread.
+/// @param delay_ms Delay in milliseconds.
+void vclock_advance(unsigned int delay_ms);
+
+/// Returns the simulated time of a logical thread, in nanoseconds.
+/// @param id Logical thread id, starting at 1.
+uint64_t vclock_time(int id);
+
+/// Moves every logical thread to the simulated time of the latest one, as a
+/// barrier only releases them once the last has arrived.
+void vclock_barrier();
+
+/// Returns the simulated time the process spent, in nanoseconds.
+uint64_t vclock_elapsed();
+
+/// Frees the clocks of the logical threads.
+void vclock_close();
+
+/// Returns the CPU time the process used, in nanoseconds.
+uint64_t vclock_cpu_time();
+
+#endif // EMS_VCLOCK_H
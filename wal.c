@@ -0,0 +1,710 @@
+#include "wal.h"
+#include "varint.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Record types
+#define WAL_CREATE 1
+#define WAL_RESERVE 2
+#define WAL_CANCEL 3
+#define WAL_RESERVE_MULTI 4
+
+/// Per-thread append buffer. Each worker owns one, so appending a record
+/// only takes an uncontended lock; the commit thread drains all of them.
+struct WalBuffer {
+    pthread_mutex_t lock;
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    int in_use;             // Owned by a live thread
+    struct WalBuffer *next; // Next registered buffer
+};
+
+/// Part of a record being appended: varint fields followed by seat spans.
+struct WalPart {
+    const uint64_t *fields;
+    size_t num_fields;
+    const struct SeatSpan *spans;
+    size_t num_spans;
+};
+
+/// A record and its sequence number. When it is committed, body and len
+/// cover the whole encoded record; when it is replayed, its body after the
+/// sequence number.
+struct WalRecord {
+    uint64_t lsn;
+    const unsigned char *body;
+    size_t len;
+};
+
+static unsigned int commit_interval_ms = 0;
+static size_t commit_batch_bytes = 0;
+
+static int wal_fd = -1;
+static pthread_t commit_thread;
+static pthread_key_t buffer_key;
+
+// Registered buffers, protected by registry_lock
+static struct WalBuffer *buffers = NULL;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Wakes the commit thread, protected by commit_lock
+static pthread_mutex_t commit_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t commit_cond = PTHREAD_COND_INITIALIZER;
+static int stopping = 0;
+
+// Log sequence number of the next record
+static atomic_uint_fast64_t next_lsn = 0;
+// Bytes appended but not yet committed
+static atomic_size_t pending_bytes = 0;
+
+// Staging area the commit thread drains the buffers into. The records held
+// back by the last commit stay at its start
+static unsigned char *staging = NULL;
+static size_t staging_cap = 0;
+static size_t held_bytes = 0;
+
+// Records of the staging area, and the buffer they are written from in LSN
+// order
+static struct WalRecord *staged_records = NULL;
+static size_t staged_records_cap = 0;
+static unsigned char *ordered = NULL;
+static size_t ordered_cap = 0;
+
+// Sequence number of the next record to be written to the log
+static uint64_t durable_lsn = 0;
+
+// Grow a byte buffer so that it can hold at least `needed` bytes.
+static int reserve_bytes(unsigned char **data, size_t *cap, size_t needed) {
+    if (needed <= *cap) {
+        return 0;
+    }
+
+    size_t new_cap = *cap ? *cap : 4096;
+    while (new_cap < needed) {
+        new_cap *= 2;
+    }
+
+    unsigned char *new_data = realloc(*data, new_cap);
+    if (new_data == NULL) {
+        return 1;
+    }
+
+    *data = new_data;
+    *cap = new_cap;
+    return 0;
+}
+
+// Called when a worker thread exits, so its buffer can be reused.
+static void release_buffer(void *arg) {
+    struct WalBuffer *buffer = arg;
+    pthread_mutex_lock(&registry_lock);
+    buffer->in_use = 0;
+    pthread_mutex_unlock(&registry_lock);
+}
+
+// Get the calling thread's buffer, registering one on first use.
+static struct WalBuffer *get_local_buffer() {
+    struct WalBuffer *buffer = pthread_getspecific(buffer_key);
+    if (buffer != NULL) {
+        return buffer;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    for (buffer = buffers; buffer != NULL; buffer = buffer->next) {
+        if (!buffer->in_use) {
+            break;
+        }
+    }
+
+    if (buffer == NULL) {
+        buffer = calloc(1, sizeof(struct WalBuffer));
+        if (buffer == NULL) {
+            pthread_mutex_unlock(&registry_lock);
+            return NULL;
+        }
+        pthread_mutex_init(&buffer->lock, NULL);
+        buffer->next = buffers;
+        buffers = buffer;
+    }
+
+    buffer->in_use = 1;
+    pthread_mutex_unlock(&registry_lock);
+
+    pthread_setspecific(buffer_key, buffer);
+    return buffer;
+}
+
+// Append an encoded record (length prefix + body) to the thread's buffer.
+static void append_record(unsigned char type, const struct WalPart *parts,
+                          size_t num_parts) {
+    struct WalBuffer *buffer = get_local_buffer();
+    if (buffer == NULL) {
+        fprintf(stderr, "Error allocating log buffer\n");
+        return;
+    }
+
+    pthread_mutex_lock(&buffer->lock);
+
+    size_t fields_len = 1;
+    for (size_t p = 0; p < num_parts; p++) {
+        const struct WalPart *part = &parts[p];
+        for (size_t i = 0; i < part->num_fields; i++) {
+            fields_len += varint_size(part->fields[i]);
+        }
+        for (size_t i = 0; i < part->num_spans; i++) {
+            const struct SeatSpan *span = &part->spans[i];
+            fields_len += varint_size(span->row) + varint_size(span->col_from) +
+                          varint_size(span->col_to - span->col_from);
+        }
+    }
+
+    // Make room before the record is numbered: a number whose record is
+    // never appended would hold every later record back from the log
+    if (reserve_bytes(&buffer->data, &buffer->cap,
+                      buffer->len + 2 * VARINT_MAX_BYTES + fields_len) != 0) {
+        pthread_mutex_unlock(&buffer->lock);
+        fprintf(stderr, "Error allocating log buffer\n");
+        return;
+    }
+
+    // The sequence number is taken under the buffer lock, so a record is
+    // never numbered before it is visible to the commit thread.
+    uint64_t lsn = atomic_fetch_add(&next_lsn, 1);
+
+    size_t body_len = varint_size(lsn) + fields_len;
+    size_t record_len = varint_size(body_len) + body_len;
+
+    unsigned char *out = buffer->data + buffer->len;
+    out = put_varint(out, body_len);
+    out = put_varint(out, lsn);
+    *out++ = type;
+    for (size_t p = 0; p < num_parts; p++) {
+        const struct WalPart *part = &parts[p];
+        for (size_t i = 0; i < part->num_fields; i++) {
+            out = put_varint(out, part->fields[i]);
+        }
+        // Spans are stored as row, first column and width - 1
+        for (size_t i = 0; i < part->num_spans; i++) {
+            const struct SeatSpan *span = &part->spans[i];
+            out = put_varint(out, span->row);
+            out = put_varint(out, span->col_from);
+            out = put_varint(out, span->col_to - span->col_from);
+        }
+    }
+    buffer->len += record_len;
+
+    pthread_mutex_unlock(&buffer->lock);
+
+    // Wake the commit thread early once a full batch is pending
+    size_t pending = atomic_fetch_add(&pending_bytes, record_len);
+    if (pending < commit_batch_bytes &&
+        pending + record_len >= commit_batch_bytes) {
+        pthread_mutex_lock(&commit_lock);
+        pthread_cond_signal(&commit_cond);
+        pthread_mutex_unlock(&commit_lock);
+    }
+}
+
+static int compare_records(const void *a, const void *b) {
+    uint64_t lsn_a = ((const struct WalRecord *)a)->lsn;
+    uint64_t lsn_b = ((const struct WalRecord *)b)->lsn;
+    return (lsn_a > lsn_b) - (lsn_a < lsn_b);
+}
+
+// Index the records of the staging area by sequence number.
+// Returns the number of records, SIZE_MAX if they could not be indexed.
+static size_t index_staged_records(size_t staged) {
+    size_t num_records = 0;
+    const unsigned char *in = staging, *end = staging + staged;
+    while (in < end) {
+        const unsigned char *start = in, *body;
+        uint64_t len, lsn;
+        get_varint(&in, end, &len);
+        body = in;
+        get_varint(&body, end, &lsn);
+        in += len;
+
+        if (num_records == staged_records_cap) {
+            size_t cap = staged_records_cap ? staged_records_cap * 2 : 64;
+            struct WalRecord *grown =
+                realloc(staged_records, cap * sizeof(struct WalRecord));
+            if (grown == NULL) {
+                return SIZE_MAX;
+            }
+            staged_records = grown;
+            staged_records_cap = cap;
+        }
+        staged_records[num_records++] =
+            (struct WalRecord){lsn, start, (size_t)(in - start)};
+    }
+
+    qsort(staged_records, num_records, sizeof(struct WalRecord),
+          compare_records);
+    return num_records;
+}
+
+// Drain every thread buffer and write the records to the log in LSN order,
+// with a single fsync. A record may be numbered just before the buffer it
+// goes to is drained, while later ones reach other buffers in time; those
+// are held back until it arrives, so the log is always a prefix of the
+// operations performed.
+static void commit_pending() {
+    size_t staged = held_bytes;
+
+    pthread_mutex_lock(&registry_lock);
+    for (struct WalBuffer *buffer = buffers; buffer != NULL;
+         buffer = buffer->next) {
+        pthread_mutex_lock(&buffer->lock);
+        if (buffer->len > 0 &&
+            reserve_bytes(&staging, &staging_cap, staged + buffer->len) == 0) {
+            memcpy(staging + staged, buffer->data, buffer->len);
+            staged += buffer->len;
+            buffer->len = 0;
+        }
+        pthread_mutex_unlock(&buffer->lock);
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    // Nothing held back can be written before new records arrive
+    if (staged == held_bytes) {
+        return;
+    }
+    atomic_fetch_sub(&pending_bytes, staged - held_bytes);
+
+    size_t num_records = index_staged_records(staged);
+    if (num_records == SIZE_MAX ||
+        reserve_bytes(&ordered, &ordered_cap, staged) != 0) {
+        fprintf(stderr, "Error allocating log buffer\n");
+        held_bytes = staged; // Try again on the next commit
+        return;
+    }
+
+    // Lay the records out in LSN order; those following the last written
+    // one with no gap are written now
+    size_t ready = 0, ready_bytes = 0, offset = 0;
+    for (size_t i = 0; i < num_records; i++) {
+        memcpy(ordered + offset, staged_records[i].body,
+               staged_records[i].len);
+        offset += staged_records[i].len;
+        if (ready == i && staged_records[i].lsn == durable_lsn + i) {
+            ready++;
+            ready_bytes = offset;
+        }
+    }
+
+    held_bytes = staged - ready_bytes;
+    memcpy(staging, ordered + ready_bytes, held_bytes);
+    durable_lsn += ready;
+    if (ready_bytes == 0) {
+        return;
+    }
+
+    size_t written = 0;
+    while (written < ready_bytes) {
+        ssize_t result =
+            write(wal_fd, ordered + written, ready_bytes - written);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Error writing log");
+            return;
+        }
+        written += (size_t)result;
+    }
+
+    if (fsync(wal_fd) == -1) {
+        perror("Error syncing log");
+    }
+}
+
+// Group commit loop: one write and fsync per interval or full batch.
+static void *commit_loop(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&commit_lock);
+    while (!stopping) {
+        if (atomic_load(&pending_bytes) < commit_batch_bytes) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += commit_interval_ms / 1000;
+            deadline.tv_nsec += (long)(commit_interval_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&commit_cond, &commit_lock, &deadline);
+        }
+
+        pthread_mutex_unlock(&commit_lock);
+        commit_pending();
+        pthread_mutex_lock(&commit_lock);
+    }
+    pthread_mutex_unlock(&commit_lock);
+
+    // Final commit after the last worker has finished
+    commit_pending();
+    return NULL;
+}
+
+void wal_configure(unsigned int interval_ms, size_t batch_bytes) {
+    commit_interval_ms = interval_ms;
+    commit_batch_bytes = batch_bytes;
+}
+
+int wal_enabled() { return commit_interval_ms > 0; }
+
+int wal_open(const char *path) {
+    if (wal_fd != -1) {
+        fprintf(stderr, "Log has already been opened\n");
+        return 1;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if (fd == -1) {
+        perror("Error opening log");
+        return 1;
+    }
+
+    if (pthread_key_create(&buffer_key, release_buffer) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    wal_fd = fd;
+    stopping = 0;
+    durable_lsn = atomic_load(&next_lsn);
+    held_bytes = 0;
+
+    if (pthread_create(&commit_thread, NULL, commit_loop, NULL) != 0) {
+        perror("Error creating log thread");
+        pthread_key_delete(buffer_key);
+        close(fd);
+        wal_fd = -1;
+        return 1;
+    }
+
+    return 0;
+}
+
+int wal_close() {
+    if (wal_fd == -1) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&commit_lock);
+    stopping = 1;
+    pthread_cond_signal(&commit_cond);
+    pthread_mutex_unlock(&commit_lock);
+    pthread_join(commit_thread, NULL);
+
+    pthread_key_delete(buffer_key);
+
+    // Free every thread buffer
+    pthread_mutex_lock(&registry_lock);
+    while (buffers != NULL) {
+        struct WalBuffer *next = buffers->next;
+        pthread_mutex_destroy(&buffers->lock);
+        free(buffers->data);
+        free(buffers);
+        buffers = next;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    free(staging);
+    staging = NULL;
+    staging_cap = 0;
+    held_bytes = 0;
+    free(staged_records);
+    staged_records = NULL;
+    staged_records_cap = 0;
+    free(ordered);
+    ordered = NULL;
+    ordered_cap = 0;
+
+    int result = close(wal_fd);
+    wal_fd = -1;
+    return result != 0;
+}
+
+void wal_log_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+    if (wal_fd == -1) {
+        return;
+    }
+
+    uint64_t fields[] = {event_id, num_rows, num_cols};
+    struct WalPart part = {fields, 3, NULL, 0};
+    append_record(WAL_CREATE, &part, 1);
+}
+
+void wal_log_reserve(unsigned int event_id, unsigned int reservation_id,
+                     size_t num_spans, const struct SeatSpan *spans) {
+    if (wal_fd == -1) {
+        return;
+    }
+
+    uint64_t fields[] = {event_id, reservation_id, num_spans};
+    struct WalPart part = {fields, 3, spans, num_spans};
+    append_record(WAL_RESERVE, &part, 1);
+}
+
+void wal_log_reserve_multi(size_t num_events, const unsigned int *event_ids,
+                           const unsigned int *reservation_ids,
+                           const size_t *num_spans,
+                           const struct SeatSpan *const *spans) {
+    if (wal_fd == -1) {
+        return;
+    }
+
+    // A count followed by one RESERVE body per event, in a single record
+    uint64_t *fields = malloc((1 + 3 * num_events) * sizeof(uint64_t));
+    struct WalPart *parts = malloc((1 + num_events) * sizeof(struct WalPart));
+    if (fields == NULL || parts == NULL) {
+        fprintf(stderr, "Error allocating log buffer\n");
+        free(fields);
+        free(parts);
+        return;
+    }
+
+    fields[0] = num_events;
+    parts[0] = (struct WalPart){fields, 1, NULL, 0};
+    for (size_t i = 0; i < num_events; i++) {
+        uint64_t *event_fields = &fields[1 + 3 * i];
+        event_fields[0] = event_ids[i];
+        event_fields[1] = reservation_ids[i];
+        event_fields[2] = num_spans[i];
+        parts[1 + i] = (struct WalPart){event_fields, 3, spans[i], num_spans[i]};
+    }
+
+    append_record(WAL_RESERVE_MULTI, parts, 1 + num_events);
+    free(fields);
+    free(parts);
+}
+
+void wal_log_cancel(unsigned int event_id, unsigned int reservation_id) {
+    if (wal_fd == -1) {
+        return;
+    }
+
+    uint64_t fields[] = {event_id, reservation_id};
+    struct WalPart part = {fields, 2, NULL, 0};
+    append_record(WAL_CANCEL, &part, 1);
+}
+
+// Read the spans of a RESERVE body, after its event, reservation and number
+// of spans.
+static struct SeatSpan *read_spans(const unsigned char **in,
+                                   const unsigned char *end,
+                                   uint64_t num_spans) {
+    // Every span takes at least three bytes
+    if (num_spans == 0 || num_spans > (uint64_t)(end - *in) / 3) {
+        return NULL;
+    }
+
+    struct SeatSpan *spans = malloc((size_t)num_spans * sizeof(struct SeatSpan));
+    for (size_t i = 0; spans != NULL && i < num_spans; i++) {
+        uint64_t row, col, width;
+        if (get_varint(in, end, &row) || get_varint(in, end, &col) ||
+            get_varint(in, end, &width)) {
+            free(spans);
+            return NULL;
+        }
+        spans[i] = (struct SeatSpan){(size_t)row, (size_t)col,
+                                     (size_t)(col + width)};
+    }
+    return spans;
+}
+
+// Apply the RESERVE bodies of a record, one per event, all of them or none.
+static int replay_reserve(const unsigned char **in, const unsigned char *end,
+                          uint64_t num_events) {
+    // Every body takes at least six bytes
+    if (num_events == 0 || num_events > (uint64_t)(end - *in) / 6) {
+        return 1;
+    }
+
+    size_t count = (size_t)num_events;
+    unsigned int *event_ids = malloc(count * sizeof(unsigned int));
+    unsigned int *reservation_ids = malloc(count * sizeof(unsigned int));
+    size_t *num_spans = malloc(count * sizeof(size_t));
+    struct SeatSpan **spans = calloc(count, sizeof(struct SeatSpan *));
+    int result = event_ids == NULL || reservation_ids == NULL ||
+                 num_spans == NULL || spans == NULL;
+
+    // Parse every body before any of them is applied
+    for (size_t i = 0; !result && i < count; i++) {
+        uint64_t event_id, reservation_id, spans_count;
+        result = get_varint(in, end, &event_id) ||
+                 get_varint(in, end, &reservation_id) ||
+                 get_varint(in, end, &spans_count) ||
+                 event_id > UINT32_MAX || reservation_id > UINT32_MAX;
+        if (!result) {
+            event_ids[i] = (unsigned int)event_id;
+            reservation_ids[i] = (unsigned int)reservation_id;
+            num_spans[i] = (size_t)spans_count;
+            spans[i] = read_spans(in, end, spans_count);
+            result = spans[i] == NULL;
+        }
+    }
+
+    if (!result) {
+        result = ems_replay_reserve(count, event_ids, reservation_ids,
+                                    num_spans,
+                                    (const struct SeatSpan *const *)spans);
+    }
+
+    for (size_t i = 0; spans != NULL && i < count; i++) {
+        free(spans[i]);
+    }
+    free(event_ids);
+    free(reservation_ids);
+    free(num_spans);
+    free(spans);
+    return result;
+}
+
+// Apply a single record body (after its sequence number).
+static int replay_record(const unsigned char *in, const unsigned char *end) {
+    if (in == end) {
+        return 1;
+    }
+    unsigned char type = *in++;
+
+    // A reservation, or a group of them made atomically across events
+    if (type == WAL_RESERVE || type == WAL_RESERVE_MULTI) {
+        uint64_t num_events = 1;
+        if (type == WAL_RESERVE_MULTI && get_varint(&in, end, &num_events)) {
+            return 1;
+        }
+        return replay_reserve(&in, end, num_events);
+    }
+
+    uint64_t event_id, a, b;
+    if (get_varint(&in, end, &event_id) || get_varint(&in, end, &a) ||
+        event_id > UINT32_MAX) {
+        return 1;
+    }
+
+    if (type == WAL_CANCEL) {
+        return a > UINT32_MAX ||
+               ems_cancel((unsigned int)event_id, (unsigned int)a);
+    }
+
+    if (get_varint(&in, end, &b)) {
+        return 1;
+    }
+
+    return type != WAL_CREATE ||
+           ems_create((unsigned int)event_id, (size_t)a, (size_t)b);
+}
+
+long wal_replay(const char *path) {
+    int fd = open(path, O_RDWR);
+    if (fd == -1) {
+        // Nothing to recover
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    unsigned char *log = malloc(size ? size : 1);
+    size_t done = 0;
+    while (log != NULL && done < size) {
+        ssize_t result = read(fd, log + done, size - done);
+        if (result <= 0) {
+            break;
+        }
+        done += (size_t)result;
+    }
+
+    // A short read would make the unread records look torn
+    if (log == NULL || done < size) {
+        close(fd);
+        free(log);
+        return -1;
+    }
+
+    // Index the complete records; a torn record ends the log
+    struct WalRecord *records = NULL;
+    size_t num_records = 0, records_cap = 0;
+    const unsigned char *in = log, *end = log + done, *valid = log;
+    while (in < end) {
+        uint64_t len;
+        if (get_varint(&in, end, &len) || len > (uint64_t)(end - in)) {
+            break;
+        }
+
+        struct WalRecord record = {0, in, (size_t)len};
+        const unsigned char *body = in;
+        if (get_varint(&body, in + len, &record.lsn)) {
+            break;
+        }
+        record.len -= (size_t)(body - in);
+        record.body = body;
+        in += len;
+        valid = in;
+
+        if (num_records == records_cap) {
+            records_cap = records_cap ? records_cap * 2 : 64;
+            struct WalRecord *grown =
+                realloc(records, records_cap * sizeof(struct WalRecord));
+            if (grown == NULL) {
+                close(fd);
+                free(records);
+                free(log);
+                return -1;
+            }
+            records = grown;
+        }
+        records[num_records++] = record;
+    }
+
+    // Cut the torn record off, so that the records appended from now on
+    // follow the last complete one instead of being hidden behind it
+    if (valid < end) {
+        fprintf(stderr, "Discarding %zu bytes of a torn log record\n",
+                (size_t)(end - valid));
+        if (ftruncate(fd, (off_t)(valid - log)) == -1) {
+            perror("Error truncating log");
+            close(fd);
+            free(records);
+            free(log);
+            return -1;
+        }
+    }
+    close(fd);
+
+    // Records are committed in LSN order, which is the order they are
+    // replayed in
+    long replayed = 0;
+    for (size_t i = 0; i < num_records; i++) {
+        if (replay_record(records[i].body, records[i].body + records[i].len)) {
+            fprintf(stderr, "Failed to replay log record\n");
+            continue;
+        }
+        replayed++;
+    }
+
+    if (num_records > 0) {
+        atomic_store(&next_lsn, records[num_records - 1].lsn + 1);
+    }
+
+    free(records);
+    free(log);
+    return replayed;
+}
@@ -0,0 +1,48 @@
+#ifndef EMS_WAL_H
+#define EMS_WAL_H
+
+#include "operations.h"
+#include <stddef.h>
+
+/// Sets the group commit parameters used by the next wal_open().
+/// @param interval_ms Maximum time between two fsyncs of the log.
+/// @param batch_bytes Number of pending bytes that triggers an early commit.
+void wal_configure(unsigned int interval_ms, size_t batch_bytes);
+
+/// Returns whether the write-ahead log was enabled with wal_configure().
+int wal_enabled();
+
+/// Opens (or creates) the log file and starts the group commit thread.
+/// @param path Path of the log file.
+/// @return 0 if the log was opened successfully, 1 otherwise.
+int wal_open(const char *path);
+
+/// Commits every pending record, stops the commit thread and closes the log.
+/// @return 0 if the log was closed successfully, 1 otherwise.
+int wal_close();
+
+/// Appends a CREATE record to the calling thread's log buffer.
+void wal_log_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Appends a RESERVE record to the calling thread's log buffer.
+void wal_log_reserve(unsigned int event_id, unsigned int reservation_id,
+                     size_t num_spans, const struct SeatSpan *spans);
+
+/// Appends a single record holding the RESERVEs of an atomic reservation
+/// across several events, so they are replayed all or not at all.
+void wal_log_reserve_multi(size_t num_events, const unsigned int *event_ids,
+                           const unsigned int *reservation_ids,
+                           const size_t *num_spans,
+                           const struct SeatSpan *const *spans);
+
+/// Appends a CANCEL record to the calling thread's log buffer.
+void wal_log_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Replays every complete record of a log into the EMS state, in the order
+/// the operations were performed, and cuts off a torn record at its end.
+/// Must be called before wal_open().
+/// @param path Path of the log file.
+/// @return Number of records replayed, -1 on error.
+long wal_replay(const char *path);
+
+#endif // EMS_WAL_H